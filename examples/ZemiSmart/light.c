@@ -82,22 +82,97 @@ void hsi2rgbw(float h, float s, float i, int* rgbw) {
 #define PIN_DI 				13
 #define PIN_DCKI 			15
 
-float hue,sat,bri;
-bool on;
+// Number of chained MY9291 chips; each one is its own HomeKit lightbulb.
+// The ZemiSmart bulb has a single chip, multi-zone panels up to 4.
+#ifndef LIGHT_ZONES
+#define LIGHT_ZONES 			1
+#endif
+#if LIGHT_ZONES > MJPWM_MAX_CHIPS
+#error "LIGHT_ZONES exceeds MJPWM_MAX_CHIPS"
+#endif
+
+typedef struct {
+    float hue,sat,bri;
+    bool on;
+} light_zone_t;
+
+light_zone_t zones[LIGHT_ZONES];
+
+// Fade engine: lightSET only posts a new target, light_fade_task walks
+// the duties there in LIGHT_FADE_STEPS ticks using Q16 fixed point.
+#define LIGHT_FADE_TICK_MS 		20
+#define LIGHT_FADE_MS 			400
+#define LIGHT_FADE_STEPS 		(LIGHT_FADE_MS / LIGHT_FADE_TICK_MS)
+
+uint16_t fade_target[LIGHT_ZONES][4];
+bool fade_pending, fade_resend;
+TaskHandle_t fade_task_handle;
+
+void light_fade_task(void *_args) {
+    int32_t level[LIGHT_ZONES][4] = {{0}}, step[LIGHT_ZONES][4];
+    uint16_t target[LIGHT_ZONES][4], duty[LIGHT_ZONES][4], sent[LIGHT_ZONES][4] = {{0}};
+    int n, c, steps = 0;
+    bool changed;
+    TickType_t wake = 0;
+
+    while (1) {
+        if (!steps) { //idle until lightSET posts a target
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            wake = xTaskGetTickCount();
+        }
+
+        taskENTER_CRITICAL();
+        if (fade_pending) { //all writes since the last tick collapse into one target
+            for (n=0;n<LIGHT_ZONES;n++) for (c=0;c<4;c++) {
+                target[n][c] = fade_target[n][c];
+                step[n][c] = (((int32_t)target[n][c] << 16) - level[n][c]) / LIGHT_FADE_STEPS;
+            }
+            steps = LIGHT_FADE_STEPS;
+            fade_pending = false;
+        }
+        changed = fade_resend;
+        fade_resend = false;
+        taskEXIT_CRITICAL();
+
+        if (steps) steps--;
+        for (n=0;n<LIGHT_ZONES;n++) for (c=0;c<4;c++) {
+            if (steps) level[n][c] += step[n][c];
+            else level[n][c] = (int32_t)target[n][c] << 16;
+            duty[n][c] = (level[n][c] + 0x8000) >> 16;
+            if (duty[n][c] != sent[n][c]) changed = true;
+        }
+
+        if (changed) { //only send a frame when the output moves
+            mjpwm_send_duty_chain(duty);
+            for (n=0;n<LIGHT_ZONES;n++) for (c=0;c<4;c++) sent[n][c] = duty[n][c];
+        }
+        if (steps) vTaskDelayUntil(&wake, LIGHT_FADE_TICK_MS / portTICK_PERIOD_MS);
+    }
+}
 
 void lightSET(void) {
     int rgbw[4];
-    if (on) {
-        printf("h=%d,s=%d,b=%d => ",(int)hue,(int)sat,(int)bri);
-        
-        hsi2rgbw(hue,sat,bri,rgbw);
-        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
-        
-        mjpwm_send_duty(rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
-    } else {
-        printf("off\n");
-        mjpwm_send_duty(     0,      0,      0,      0 );
+    uint16_t duty[LIGHT_ZONES][4];
+
+    for (int n=0;n<LIGHT_ZONES;n++) {
+        light_zone_t *zone=&zones[n];
+        if (zone->on) {
+            printf("%d: h=%d,s=%d,b=%d => ",n,(int)zone->hue,(int)zone->sat,(int)zone->bri);
+
+            hsi2rgbw(zone->hue,zone->sat,zone->bri,rgbw);
+            printf("r=%d,g=%d,b=%d,w=%d\n",rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
+        } else {
+            printf("%d: off\n",n);
+            rgbw[0]=rgbw[1]=rgbw[2]=rgbw[3]=0;
+        }
+        for (int c=0;c<4;c++) duty[n][c]=rgbw[c];
     }
+
+    taskENTER_CRITICAL();
+    for (int n=0;n<LIGHT_ZONES;n++) for (int c=0;c<4;c++) fade_target[n][c]=duty[n][c];
+    fade_pending=true;
+    taskEXIT_CRITICAL();
+    xTaskNotifyGive(fade_task_handle);
 }
 
 void light_init() {
@@ -109,56 +184,47 @@ void light_init() {
         .one_shot = MJPWM_CMD_ONE_SHOT_DISABLE,
         .resv = 0,
     };
-    mjpwm_init(PIN_DI, PIN_DCKI, 1, init_cmd);
-    on=true; hue=0; sat=0; bri=100; //this should not be here, but part of the homekit init work
+    mjpwm_init(PIN_DI, PIN_DCKI, LIGHT_ZONES, init_cmd);
+    xTaskCreate(light_fade_task, "Light fade", 512, NULL, 3, &fade_task_handle);
+    for (int n=0;n<LIGHT_ZONES;n++) { //this should not be here, but part of the homekit init work
+        zones[n].on=true; zones[n].hue=0; zones[n].sat=0; zones[n].bri=100;
+    }
     lightSET();
 }
 
-homekit_value_t light_on_get() {
-    return HOMEKIT_BOOL(on);
-}
-void light_on_set(homekit_value_t value) {
+void light_on_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_bool) {
         printf("Invalid on-value format: %d\n", value.format);
         return;
     }
-    on = value.bool_value;
+    ((light_zone_t*)context)->on = value.bool_value;
     lightSET();
 }
 
-homekit_value_t light_bri_get() {
-    return HOMEKIT_INT(bri);
-}
-void light_bri_set(homekit_value_t value) {
+void light_bri_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_int) {
         printf("Invalid bri-value format: %d\n", value.format);
         return;
     }
-    bri = value.int_value;
+    ((light_zone_t*)context)->bri = value.int_value;
     lightSET();
 }
 
-homekit_value_t light_hue_get() {
-    return HOMEKIT_FLOAT(hue);
-}
-void light_hue_set(homekit_value_t value) {
+void light_hue_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
         printf("Invalid hue-value format: %d\n", value.format);
         return;
     }
-    hue = value.float_value;
+    ((light_zone_t*)context)->hue = value.float_value;
     lightSET();
 }
 
-homekit_value_t light_sat_get() {
-    return HOMEKIT_FLOAT(sat);
-}
-void light_sat_set(homekit_value_t value) {
+void light_sat_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
         printf("Invalid sat-value format: %d\n", value.format);
         return;
     }
-    sat = value.float_value;
+    ((light_zone_t*)context)->sat = value.float_value;
     lightSET();
 }
 
@@ -172,17 +238,55 @@ void light_identify_task(void *_args) {
         mjpwm_send_duty(   0,    0, 4095,    0);
         vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
     }
+    fade_resend=true; //the chips no longer show what the fade engine last sent
     lightSET();
 
     vTaskDelete(NULL);
 }
 
+#ifdef MJPWM_TIMING
+static void light_print_cycles(const char *name, const mjpwm_cycles_t *cycles) {
+    printf("mjpwm %s: %u sends, cycles min %u, avg %u, max %u\n", name, cycles->count, cycles->min,
+        cycles->count ? (uint32_t)(cycles->sum / cycles->count) : 0, cycles->max);
+}
+#endif
+
 void light_identify(homekit_value_t _value) {
     printf("Light Identify\n");
+#ifdef MJPWM_TIMING
+    mjpwm_cycles_t data, latch;
+
+    mjpwm_get_critical_cycles(&data, &latch);
+    light_print_cycles("data", &data);
+    light_print_cycles("latch", &latch);
+#endif
     xTaskCreate(light_identify_task, "Light identify", 256, NULL, 2, NULL);
 }
 
 
+#define LIGHT_SERVICE(n, name) \
+    HOMEKIT_SERVICE(LIGHTBULB, .primary=(n == 0), \
+        .characteristics=(homekit_characteristic_t*[]){ \
+            HOMEKIT_CHARACTERISTIC(NAME, name), \
+            HOMEKIT_CHARACTERISTIC( \
+                ON, true, \
+                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_on_callback, .context=&zones[n]) \
+            ), \
+            HOMEKIT_CHARACTERISTIC( \
+                BRIGHTNESS, 100, \
+                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_bri_callback, .context=&zones[n]) \
+            ), \
+            HOMEKIT_CHARACTERISTIC( \
+                HUE, 0, \
+                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_hue_callback, .context=&zones[n]) \
+            ), \
+            HOMEKIT_CHARACTERISTIC( \
+                SATURATION, 0, \
+                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_sat_callback, .context=&zones[n]) \
+            ), \
+            NULL \
+        })
+
 homekit_accessory_t *accessories[] = {
     HOMEKIT_ACCESSORY(
         .id=1,
@@ -198,30 +302,16 @@ homekit_accessory_t *accessories[] = {
                     HOMEKIT_CHARACTERISTIC(IDENTIFY, light_identify),
                     NULL
                 }),
-            HOMEKIT_SERVICE(LIGHTBULB, .primary=true,
-                .characteristics=(homekit_characteristic_t*[]){
-                    HOMEKIT_CHARACTERISTIC(
-                        ON, true,
-                        .getter=light_on_get,
-                        .setter=light_on_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        BRIGHTNESS, 100,
-                        .getter=light_bri_get,
-                        .setter=light_bri_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        HUE, 0,
-                        .getter=light_hue_get,
-                        .setter=light_hue_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        SATURATION, 0,
-                        .getter=light_sat_get,
-                        .setter=light_sat_set
-                    ),
-                    NULL
-                }),
+            LIGHT_SERVICE(0, "Light"),
+#if LIGHT_ZONES > 1
+            LIGHT_SERVICE(1, "Light 2"),
+#endif
+#if LIGHT_ZONES > 2
+            LIGHT_SERVICE(2, "Light 3"),
+#endif
+#if LIGHT_ZONES > 3
+            LIGHT_SERVICE(3, "Light 4"),
+#endif
             NULL
         }),
     NULL
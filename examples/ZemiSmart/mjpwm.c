@@ -14,6 +14,9 @@
 #include <espressif/esp_misc.h>  //defines sdk_os_delay_us
 #include <task.h>
 #include <esp/gpio.h>
+#ifdef MJPWM_TIMING
+#include <xtensa/hal.h>  //defines xthal_get_ccount
+#endif
 
 #define GPIO_MAX_INDEX 16
 
@@ -43,6 +46,28 @@ static uint8_t pin_dcki = 15;
 
 static mjpwm_cmd_t mjpwm_commands[GPIO_MAX_INDEX + 1];
 
+// One DI mask (BIT(pin_di) or 0) per bit to be clocked out, so the
+// critical section does nothing but store precomputed words to GPIO.OUT.
+static uint16_t mjpwm_stream[MJPWM_MAX_CHIPS * 4 * 16];
+
+#ifdef MJPWM_TIMING
+static mjpwm_cycles_t mjpwm_data_cycles;
+static mjpwm_cycles_t mjpwm_latch_cycles;
+
+// Called with interrupts still disabled, so readers see whole updates.
+static IRAM void mjpwm_cycles_add(mjpwm_cycles_t *cycles, uint32_t start)
+{
+    uint32_t taken = xthal_get_ccount() - start;
+
+    if (!cycles->count || taken < cycles->min)
+        cycles->min = taken;
+    if (taken > cycles->max)
+        cycles->max = taken;
+    cycles->sum += taken;
+    cycles->count++;
+}
+#endif
+
 IRAM void mjpwm_di_pulse(uint16_t times)
 {
     uint16_t i;
@@ -128,90 +153,141 @@ void mjpwm_send_command(mjpwm_cmd_t command)
     taskEXIT_CRITICAL(); //ets_intr_unlock();
 }
 
-IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
-        uint16_t duty_b, uint16_t duty_w)
+static uint8_t mjpwm_bit_length(void)
 {
-    uint8_t i = 0, n;
-    uint8_t channel = 0;
-    uint8_t bit_length = 8;
-    uint16_t duty_current = 0;
-
-    // Definition for RGBW channels
-    uint16_t duty[4] = { duty_r, duty_g, duty_b, duty_w };
-
     switch (mjpwm_commands[pin_dcki].bit_width) {
     case MJPWM_CMD_BIT_WIDTH_16:
-        bit_length = 16;
-        break;
+        return 16;
     case MJPWM_CMD_BIT_WIDTH_14:
-        bit_length = 14;
-        break;
+        return 14;
     case MJPWM_CMD_BIT_WIDTH_12:
-        bit_length = 12;
-        break;
+        return 12;
     case MJPWM_CMD_BIT_WIDTH_8:
-        bit_length = 8;
-        break;
     default:
-        bit_length = 8;
-        break;
+        return 8;
     }
+}
+
+// Expand the four duties of one chip into DI masks, MSB first, appended
+// to the bitstream at position pos. Returns the new stream length.
+static uint16_t mjpwm_stream_fill(uint16_t pos, uint8_t bit_length,
+        const uint16_t duty[4])
+{
+    uint8_t channel, i;
+    uint16_t duty_current;
+
+    for (channel = 0; channel < 4; channel++) {  //RGBW 4CH
+        duty_current = duty[channel];
+        for (i = 0; i < bit_length; i++) {
+            mjpwm_stream[pos++] =
+                (duty_current & (0x01 << (bit_length - 1))) ? BIT(pin_di) : 0;
+            duty_current = duty_current << 1;
+        }
+    }
+    return pos;
+}
+
+// Clock out a prepared bitstream and latch it. Only the register writes
+// run with interrupts disabled; the >12us idle gaps around the transfer
+// may be stretched by interrupts without harm, so they stay outside.
+static IRAM void mjpwm_stream_send(uint16_t length)
+{
+    uint16_t i;
+    uint32_t out, dcki = BIT(pin_dcki), di = BIT(pin_di);
+#ifdef MJPWM_TIMING
+    uint32_t start;
+#endif
 
-    taskENTER_CRITICAL(); //ets_intr_lock();
     // TStop > 12us.
     sdk_os_delay_us(12);
-    asm("nop;nop;");
 
-    for (n = 0; n < nc; n++)
-    {
-        for (channel = 0; channel < 4; channel++)   //RGBW 4CH
-        {
-            // RGBW Channel
-            duty_current = duty[channel];
-            // Send 8bit/12bit/14bit/16bit Data
-            for (i = 0; i < bit_length / 2; i++) {
-
-                // DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                // DCK = 1;
-                MJPWM_DIRECT_WRITE_HIGH(pin_dcki);
-                duty_current = duty_current << 1;
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                //DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                //DI = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_di);
-
-                duty_current = duty_current << 1;
-            }
-        }
+    taskENTER_CRITICAL(); //ets_intr_lock();
+#ifdef MJPWM_TIMING
+    start = xthal_get_ccount();
+#endif
+    out = GPIO.OUT & ~(dcki | di);
+    // Two bits per DCKI period: the first is sampled on the rising edge,
+    // the second on the falling edge.
+    for (i = 0; i < length; i += 2) {
+        GPIO.OUT = out | mjpwm_stream[i];
+        GPIO.OUT = out | mjpwm_stream[i] | dcki;
+        GPIO.OUT = out | mjpwm_stream[i + 1] | dcki;
+        GPIO.OUT = out | mjpwm_stream[i + 1];
     }
+    GPIO.OUT = out;
+#ifdef MJPWM_TIMING
+    mjpwm_cycles_add(&mjpwm_data_cycles, start);
+#endif
+    taskEXIT_CRITICAL(); //ets_intr_unlock();
 
     // TStart > 12us. Ready for send DI pulse.
     sdk_os_delay_us(12);
+
+    taskENTER_CRITICAL();
+#ifdef MJPWM_TIMING
+    start = xthal_get_ccount();
+#endif
     // Send 8 DI pulse. After 8 pulse falling edge, store old data.
-    mjpwm_di_pulse(8);
+    for (i = 0; i < 8; i++) {
+        GPIO.OUT_SET = di;
+        asm("nop;");    // delay 50ns
+        GPIO.OUT_CLEAR = di;
+        asm("nop;nop;nop;nop;nop;");
+        // delay 230ns
+    }
+#ifdef MJPWM_TIMING
+    mjpwm_cycles_add(&mjpwm_latch_cycles, start);
+#endif
+    taskEXIT_CRITICAL();
+
     // TStop > 12us.
     sdk_os_delay_us(12);
-    asm("nop;nop;");
-    taskEXIT_CRITICAL(); //ets_intr_unlock();
 }
 
+void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
+        uint16_t duty_b, uint16_t duty_w)
+{
+    uint8_t n;
+    uint8_t bit_length = mjpwm_bit_length();
+    uint16_t length = 0;
+
+    // Definition for RGBW channels
+    uint16_t duty[4] = { duty_r, duty_g, duty_b, duty_w };
+
+    // Keep other tasks off the shared bitstream; interrupts stay enabled.
+    vTaskSuspendAll();
+    for (n = 0; n < nc; n++)
+        length = mjpwm_stream_fill(length, bit_length, duty);
+
+    mjpwm_stream_send(length);
+    xTaskResumeAll();
+}
+
+void mjpwm_send_duty_chain(const uint16_t duty[][4])
+{
+    int8_t n;
+    uint8_t bit_length = mjpwm_bit_length();
+    uint16_t length = 0;
+
+    vTaskSuspendAll();
+    // Data shifts through the chain, so the farthest chip goes first.
+    for (n = nc - 1; n >= 0; n--)
+        length = mjpwm_stream_fill(length, bit_length, duty[n]);
+
+    mjpwm_stream_send(length);
+    xTaskResumeAll();
+}
+
+#ifdef MJPWM_TIMING
+void mjpwm_get_critical_cycles(mjpwm_cycles_t *data, mjpwm_cycles_t *latch)
+{
+    taskENTER_CRITICAL();
+    *data = mjpwm_data_cycles;
+    *latch = mjpwm_latch_cycles;
+    taskEXIT_CRITICAL();
+}
+#endif
+
 void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
 {
     pin_di = di;
@@ -224,7 +300,7 @@ void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
     MJPWM_DIRECT_WRITE_LOW(pin_di);
     MJPWM_DIRECT_WRITE_LOW(pin_dcki);
 
-    nc = n_chips;
+    nc = n_chips > MJPWM_MAX_CHIPS ? MJPWM_MAX_CHIPS : n_chips;
 
     // Clear all duty register
     mjpwm_dcki_pulse(32 * nc);
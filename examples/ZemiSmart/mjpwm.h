@@ -16,6 +16,8 @@
 
 #include <FreeRTOS.h>  //added for esp-open-rtos
 
+#define MJPWM_MAX_CHIPS 4
+
 typedef enum mjpwm_cmd_one_shot_t {
     MJPWM_CMD_ONE_SHOT_DISABLE = 0X00,
     MJPWM_CMD_ONE_SHOT_ENFORCE = 0X01,
@@ -64,10 +66,27 @@ typedef struct mjpwm_cmd_t {
     .resv = 0, \
 }
 
+// Duty frames are written straight to GPIO.OUT, so DI and DCKI must be
+// on GPIO0..15 (GPIO16 lives in the RTC block).
 void mjpwm_init(uint8_t pin_di, uint8_t pin_dcki, uint8_t n_chips, mjpwm_cmd_t command);
 void mjpwm_di_pulse(uint16_t times);
 void mjpwm_dcki_pulse(uint16_t times);
 void mjpwm_send_command(mjpwm_cmd_t command);
 void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g, uint16_t duty_b, uint16_t duty_w);
+// Send individual RGBW duties to every chip in one latch cycle.
+// duty[0] is the chip wired to the ESP, duty[n_chips - 1] the last one.
+void mjpwm_send_duty_chain(const uint16_t duty[][4]);
+#ifdef MJPWM_TIMING
+// CPU cycles spent with interrupts disabled per transfer, since start-up
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} mjpwm_cycles_t;
+
+// Copies the figures of the data burst and of the 8 DI latch pulses.
+void mjpwm_get_critical_cycles(mjpwm_cycles_t *data, mjpwm_cycles_t *latch);
+#endif
 
 #endif /* __MJPWM_H__ */
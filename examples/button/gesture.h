@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Button gesture recognizer.
+
+    Fed with the debounced button state once per sample, it recognizes
+    n-clicks, press-and-hold with repeats while held (dimming by holding)
+    and clicks followed by a hold. Each sample is one lookup in a small
+    state-transition table:
+
+        IDLE    --press-->   PRESSED
+        PRESSED --release--> GAP      (one more click)
+        PRESSED --timeout--> HELD     GESTURE_HOLD
+        GAP     --press-->   PRESSED
+        GAP     --timeout--> IDLE     GESTURE_CLICK
+        HELD    --timeout--> HELD     GESTURE_REPEAT
+        HELD    --release--> IDLE     GESTURE_RELEASE
+
+    Plain C without SDK dependencies, see ../host_sim/gesture_sim.c.
+*/
+
+typedef enum {
+    /* clicks short presses, each released within gap_ms of the next */
+    GESTURE_CLICK = 1,
+    /* pressed for hold_ms, after clicks short presses (0 for a plain hold) */
+    GESTURE_HOLD,
+    /* every repeat_ms while held */
+    GESTURE_REPEAT,
+    /* released after a hold, held_ms is the whole press */
+    GESTURE_RELEASE,
+} gesture_type_t;
+
+typedef struct {
+    gesture_type_t type;
+    uint8_t clicks;
+    uint32_t held_ms;
+} gesture_event_t;
+
+typedef struct {
+    /* interval of gesture_sample() calls */
+    uint16_t sample_ms;
+    /* a longer press is a hold */
+    uint16_t hold_ms;
+    /* longest release between the clicks of one gesture */
+    uint16_t gap_ms;
+    /* 0: no GESTURE_REPEAT */
+    uint16_t repeat_ms;
+    /* report as soon as this many clicks are counted, 0: no limit */
+    uint8_t max_clicks;
+} gesture_config_t;
+
+typedef struct {
+    const gesture_config_t *config;
+    /* state timeouts in samples, from config */
+    uint16_t timeout[4];
+    uint8_t state;
+    bool pressed;
+    uint8_t clicks;
+    /* samples in the current state, and of the current press */
+    uint32_t ticks;
+    uint32_t press_ticks;
+} gesture_t;
+
+void gesture_init(gesture_t *gesture, const gesture_config_t *config);
+
+/**
+    Advances the recognizer by one sample.
+
+    @param pressed The debounced button state
+    @param event Receives a recognized gesture
+    @return Whether event was filled in
+*/
+bool gesture_sample(gesture_t *gesture, bool pressed, gesture_event_t *event);
+
+/**
+    @return Whether a gesture is in progress, so sampling must go on even
+    while the button is released
+*/
+static inline bool gesture_busy(const gesture_t *gesture) {
+    return gesture->state != 0;
+}
@@ -37,22 +37,32 @@ void button_identify(homekit_value_t _value) {
 homekit_characteristic_t button_event = HOMEKIT_CHARACTERISTIC_(PROGRAMMABLE_SWITCH_EVENT, 0);
 
 
-void button_callback(uint8_t gpio, button_event_t event) {
-    switch (event) {
-        case button_event_single_press:
-            printf("single press\n");
-            homekit_characteristic_notify(&button_event, HOMEKIT_UINT8(0));
-            break;
-        case button_event_double_press:
-            printf("double press\n");
-            homekit_characteristic_notify(&button_event, HOMEKIT_UINT8(1));
+/* click, double click and hold, as the programmable switch events 0, 1 and 2 */
+const gesture_config_t button_gestures = {
+    .sample_ms = BUTTON_SAMPLE_MS,
+    .hold_ms = 1000,
+    .gap_ms = 500,
+    .max_clicks = 2,
+};
+
+
+void button_gesture(uint8_t gpio, const gesture_event_t *event) {
+    switch (event->type) {
+        case GESTURE_CLICK:
+            if (event->clicks == 1) {
+                printf("single press\n");
+                homekit_characteristic_notify(&button_event, HOMEKIT_UINT8(0));
+            } else {
+                printf("double press\n");
+                homekit_characteristic_notify(&button_event, HOMEKIT_UINT8(1));
+            }
             break;
-        case button_event_long_press:
+        case GESTURE_HOLD:
             printf("long press\n");
             homekit_characteristic_notify(&button_event, HOMEKIT_UINT8(2));
             break;
         default:
-            printf("unknown button event: %d\n", event);
+            break;
     }
 }
 
@@ -100,7 +110,8 @@ void user_init(void) {
     uart_set_baud(0, 115200);
 
     wifi_init();
-    if (button_create(BUTTON_PIN, button_callback)) {
+    if (button_create(BUTTON_PIN, true, NULL) ||
+        button_set_gestures(BUTTON_PIN, &button_gestures, button_gesture)) {
         printf("Failed to initialize button\n");
     }
     homekit_server_init(&config);
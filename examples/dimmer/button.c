@@ -1,9 +1,14 @@
 #include <string.h>
+#include <esp8266.h>
 #include <esplibs/libmain.h>
 
+#include "task.h"
 #include "timers.h"
 
 #include "button.h"
+#include "gesture.h"
+#include "input.h"
+#include "latency.h"
 
 typedef struct _button {
     /* configuration */
@@ -23,47 +28,174 @@ typedef struct _button {
     /* registered callback function */
     button_callback_fn callback;
 
+#if !BUTTON_SCANNER
     TimerHandle_t timer;
     bool timer_running;
     /* debounce state */
     int32_t integrator;
+#endif
     /* debounced button state */
     bool is_pressed;
     int pressed_ticks;
     int released_ticks;
-
-    struct _button *next;
+    /* gesture recognizer, when button_set_gestures() was called */
+    gesture_t gesture;
+    button_gesture_fn gesture_callback;
 } button_t;
 
-button_t *buttons = NULL;
+#define DEBOUNCE_TIME       0.1
+#define SAMPLE_FREQUENCY    (1000 / BUTTON_SAMPLE_MS)
+#define MAXIMUM         (DEBOUNCE_TIME * SAMPLE_FREQUENCY)
+
+/* persistence timers and callbacks, once per sample of a debounced button */
+static void button_report(button_t *button, int button_changed) {
+    /* increment persistence timer of asserted debounced button state */
+    if (button->is_pressed) {
+        button->pressed_ticks++;
+    } else {
+        button->released_ticks++;
+    }
+    if (button_changed)
+        LATENCY_MARK(LATENCY_DEBOUNCED);
+
+    /* button was just released? */
+    if (button_changed && !button->is_pressed) {
+        printf("button released after %d ms.\n", button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
+        if (button->callback) {
+            LATENCY_MARK(LATENCY_CALLBACK);
+            button->callback(button->gpio_num, button->is_pressed, button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
+        }
+        button->pressed_ticks = 0;
+    /* button is still being pressed? */
+    } else if (button->is_pressed && !button_changed) {
+        /* report pressed interval every second */
+        if ((button->pressed_ticks % SAMPLE_FREQUENCY) == 0) {
+            printf("button is already held for %d ms.\n", button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
+            if (button->callback) button->callback(button->gpio_num, button->is_pressed, button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
+        }
+    }
 
-static button_t *button_find_by_gpio(const uint8_t gpio_num) {
-    button_t *button = buttons;
-    while (button && button->gpio_num != gpio_num)
-        button = button->next;
+    /* reset persistence timer of de-asserted debounced button state */
+    if (button->is_pressed) {
+        button->released_ticks = 0;
+    }
+#if 0
+    else {
+        button->pressed_ticks = 0;
+    }
+#endif
 
-    return button;
+    if (button->gesture_callback) {
+        gesture_event_t event;
+        if (gesture_sample(&button->gesture, button->is_pressed, &event)) {
+            LATENCY_MARK(LATENCY_CALLBACK);
+            button->gesture_callback(button->gpio_num, &event);
+        }
+    }
 }
 
-static button_t *button_find_by_timer(TimerHandle_t timer) {
-    button_t *button = buttons;
-    while (button && button->timer != timer)
-        button = button->next;
+#if BUTTON_SCANNER
+/*
+ * Scanner: one timer samples GPIO0..15 with a single read of the input
+ * register and runs the integrating debounce of all buttons at once. The
+ * integrators are bit-sliced: bit n of scan_count[i] is bit i of the
+ * integrator of GPIOn, so every step is a few word operations whatever
+ * the number of buttons. Only pressed or changing buttons are visited
+ * for their callbacks, and the timer stops when all integrators are zero.
+ */
+#define SCAN_BITS           4
+#define SCAN_MAXIMUM        ((uint32_t)MAXIMUM)
+
+_Static_assert(SCAN_MAXIMUM < (1 << SCAN_BITS), "integrator does not fit SCAN_BITS");
+
+/* one bit per GPIO: registered buttons; input_xor tells which are pressed at low level */
+static uint32_t scan_mask;
+/* bit-sliced integrators and debounced states */
+static uint32_t scan_count[SCAN_BITS];
+static uint32_t scan_pressed;
+/* buttons with a gesture in progress, sampled even when released */
+static uint32_t scan_busy;
+static TimerHandle_t scan_timer;
+static volatile bool scan_running;
+
+/* inputs whose integrator equals value */
+static uint32_t button_scan_equal(uint32_t value) {
+    uint32_t equal = ~0;
+    int i;
+
+    for (i = 0; i < SCAN_BITS; i++)
+        equal &= (value & (1 << i)) ? scan_count[i] : ~scan_count[i];
+    return equal;
+}
 
-    return button;
+/* sampled pressed buttons */
+static uint32_t button_scan_sample(void) {
+    return (GPIO.IN ^ input_xor) & scan_mask;
 }
 
-#define DEBOUNCE_TIME       0.1
-#define SAMPLE_FREQUENCY    100
-#define MAXIMUM         (DEBOUNCE_TIME * SAMPLE_FREQUENCY)
+void button_scan_cb(TimerHandle_t timer) {
+    uint32_t sample = button_scan_sample();
+    uint32_t up, down, carry, borrow, t, changed, active;
+    int i;
+
+    /* integrating debounce algorithm, see button_timer_cb(); saturate at
+     * zero and SCAN_MAXIMUM */
+    up = sample & ~button_scan_equal(SCAN_MAXIMUM);
+    down = ~sample & scan_mask & ~button_scan_equal(0);
+    carry = up;
+    borrow = down;
+    for (i = 0; i < SCAN_BITS; i++) {
+        t = scan_count[i];
+        scan_count[i] = t ^ carry ^ borrow;
+        carry &= t;
+        borrow &= ~t;
+    }
+
+    /* change debounced button state when an integrator reaches a bound */
+    changed = (up & ~scan_pressed & button_scan_equal(SCAN_MAXIMUM)) |
+        (down & scan_pressed & button_scan_equal(0));
+    scan_pressed ^= changed;
+
+    active = scan_pressed | changed | scan_busy;
+    while (active) {
+        uint8_t gpio_num = __builtin_ctz(active);
+        button_t *button = input_find(gpio_num);
+
+        active &= active - 1;
+        if (!button) continue;
+        button->is_pressed = (scan_pressed >> gpio_num) & 1;
+        button_report(button, (changed >> gpio_num) & 1);
+        if (button->gesture_callback && gesture_busy(&button->gesture))
+            scan_busy |= BIT(gpio_num);
+        else
+            scan_busy &= ~BIT(gpio_num);
+    }
 
+    /* stop when all inputs are idle */
+    if (!scan_pressed && !scan_busy && (button_scan_equal(0) == ~0U)) {
+        /* any edge since the last change was a glitch */
+        latency_cancel();
+        /* with the flag and the stop in one critical section, an edge
+           either comes before and is seen by the sample below, or after
+           and queues its start behind the stop */
+        taskENTER_CRITICAL();
+        scan_running = false;
+        xTimerStop(scan_timer, 0);
+        if (button_scan_sample()) {
+            scan_running = true;
+            xTimerStart(scan_timer, 0);
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+#else
 void button_timer_cb(void *pvParameters) {
     TimerHandle_t timer = (TimerHandle_t)pvParameters;
-    button_t *button = button_find_by_timer(timer);
+    button_t *button = pvTimerGetTimerID(timer);
     if (!button) return;
 
     /* read current button state through GPIO */
-    int sample_is_pressed = (gpio_read(button->gpio_num) == button->pressed_value);
+    int sample_is_pressed = input_read(button->gpio_num);
     int button_changed = 0;
 
     /* integrating debounce algorithm */
@@ -95,52 +227,38 @@ void button_timer_cb(void *pvParameters) {
         }
     }
 
-    /* increment persistence timer of asserted debounced button state */
-    if (button->is_pressed) {
-        button->pressed_ticks++;
-    } else {
-        button->released_ticks++;
-    }
-
-    /* stop timer after button release */
-    if (!button->is_pressed && (button->integrator == 0)) {
+    /* stop timer after button release, and any gesture */
+    if (!button->is_pressed && (button->integrator == 0) && !gesture_busy(&button->gesture)) {
+        latency_cancel();
+        /* as in button_scan_cb(), an edge must not start the timer
+           between the two */
+        taskENTER_CRITICAL();
         if ((button->timer) && (button->timer_running)) {
             button->timer_running = 0;
             xTimerStop(button->timer, 0);
+            if (input_read(button->gpio_num)) {
+                button->timer_running = 1;
+                xTimerStart(button->timer, 0);
+            }
         }
+        taskEXIT_CRITICAL();
     }
 
+#ifdef BUTTON_DEBUG
     printf("int: %d, pressed: %d, changed: %d, ticks: %d\n", button->integrator, (int)button->is_pressed, button_changed, button->pressed_ticks);
 
-    /* button was just released? */
-    if (button_changed && !button->is_pressed) {
-        printf("button released after %d ms.\n", button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
-        if (button->callback) button->callback(button->gpio_num, button->is_pressed, button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
-        button->pressed_ticks = 0;
-    /* button is still being pressed? */
-    } else if (button->is_pressed && !button_changed) {
-        /* report pressed interval every second */
-        if ((button->pressed_ticks % SAMPLE_FREQUENCY) == 0) {
-            printf("button is already held for %d ms.\n", button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
-            if (button->callback) button->callback(button->gpio_num, button->is_pressed, button->pressed_ticks * (1000 / SAMPLE_FREQUENCY));
-        }
-    }
-
-    /* reset persistence timer of de-asserted debounced button state */
-    if (button->is_pressed) {
-        button->released_ticks = 0;
-    }
-#if 0
-    else {
-        button->pressed_ticks = 0;
-    }
 #endif
+
+    button_report(button, button_changed);
 }
 
+#endif
+
 void button_intr_callback(uint8_t gpio) {
-    button_t *button = button_find_by_gpio(gpio);
+    button_t *button = input_find(gpio);
     if (!button)
         return;
+    LATENCY_MARK(LATENCY_EDGE);
 
 #if 0
     uint32_t now = xTaskGetTickCountFromISR();
@@ -158,11 +276,18 @@ void button_intr_callback(uint8_t gpio) {
     }
 #endif
 
+#if BUTTON_SCANNER
+    if (!scan_running) {
+        scan_running = true;
+        xTimerStartFromISR(scan_timer, 0);
+    }
+#else
     if ((button->timer) && (!button->timer_running)) {
         //xTimerChangePeriodFromISR(button->timer, pdMS_TO_TICKS(1000 / SAMPLE_FREQUENCY), 0);
         xTimerStartFromISR(button->timer, 0);
         button->timer_running = 1;
     }
+#endif
 #if 0
     /* read current button state through GPIO */
     int button_is_pressed = (gpio_read(button->gpio_num) == button->pressed_value);
@@ -187,11 +312,20 @@ void button_intr_callback(uint8_t gpio) {
 }
 
 int button_create(const uint8_t gpio_num, bool pressed_value, button_callback_fn callback) {
-    button_t *button = button_find_by_gpio(gpio_num);
-    if (button)
+    if (input_find(gpio_num))
+        return -1;
+#if BUTTON_SCANNER
+    /* GPIO16 is not in the input register */
+    if (gpio_num > 15)
         return -1;
+    if (!scan_timer) {
+        scan_timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(1000 / SAMPLE_FREQUENCY), pdTRUE/*reload*/, 0, button_scan_cb);
+        if (!scan_timer)
+            return -1;
+    }
+#endif
 
-    button = malloc(sizeof(button_t));
+    button_t *button = malloc(sizeof(button_t));
     memset(button, 0, sizeof(*button));
     button->gpio_num = gpio_num;
 
@@ -207,40 +341,68 @@ int button_create(const uint8_t gpio_num, bool pressed_value, button_callback_fn
     button->last_transition_time = now;
     //button->glitches = 0;
 #endif
-    button->timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(1000 / SAMPLE_FREQUENCY), pdTRUE/*reload*/, 0, button_timer_cb);
-
-    button->next = buttons;
-    buttons = button;
+#if BUTTON_SCANNER
+    if (input_register(gpio_num, button)) {
+        free(button);
+        return -1;
+    }
+    /* pull-up and polarity, with the runtime configuration */
+    input_configure(gpio_num, !pressed_value);
+    scan_mask |= BIT(gpio_num);
+#else
+    button->timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(1000 / SAMPLE_FREQUENCY), pdTRUE/*reload*/, button/*id*/, button_timer_cb);
+
+    if (input_register(gpio_num, button)) {
+        xTimerDelete(button->timer, 0);
+        free(button);
+        return -1;
+    }
+    input_configure(gpio_num, !pressed_value);
+#endif
 
-    gpio_set_pullup(button->gpio_num, true, true);
     gpio_set_interrupt(button->gpio_num, GPIO_INTTYPE_EDGE_ANY, button_intr_callback);
 
     return 0;
 }
 
+int button_set_gestures(const uint8_t gpio_num, const gesture_config_t *config, button_gesture_fn callback) {
+    button_t *button = input_find(gpio_num);
+    if (!button || (config->sample_ms != 1000 / SAMPLE_FREQUENCY))
+        return -1;
+
+    taskENTER_CRITICAL();
+    gesture_init(&button->gesture, config);
+    button->gesture_callback = callback;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+/* timer task, pended by button_delete() */
+static void button_free(void *button, uint32_t unused) {
+    free(button);
+}
+
 void button_delete(const uint8_t gpio_num) {
-    if (!buttons)
+    button_t *button = input_find(gpio_num);
+    if (!button)
         return;
 
-    button_t *button = NULL;
-    if (buttons->gpio_num == gpio_num) {
-        button = buttons;
-        buttons = buttons->next;
-        if (buttons == NULL) {
-            /* last button deleted */
-        }
-    } else {
-        button_t *b = buttons;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                button = b->next;
-                b->next = b->next->next;
-                break;
-            }
-        }
-    }
-
-    if (button) {
-        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
-    }
+    gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+#if BUTTON_SCANNER
+    /* the scanner skips it from its next sample on */
+    taskENTER_CRITICAL();
+    scan_mask &= ~BIT(gpio_num);
+    scan_pressed &= ~BIT(gpio_num);
+    scan_busy &= ~BIT(gpio_num);
+    for (int i = 0; i < SCAN_BITS; i++)
+        scan_count[i] &= ~BIT(gpio_num);
+    taskEXIT_CRITICAL();
+    input_unregister(gpio_num);
+#else
+    input_unregister(gpio_num);
+    xTimerDelete(button->timer, portMAX_DELAY);
+#endif
+    /* freed on the timer task once a scan or timer callback that may still
+       be using it is done; it runs the queued commands in order */
+    xTimerPendFunctionCall(button_free, button, 0, portMAX_DELAY);
 }
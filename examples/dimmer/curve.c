@@ -0,0 +1,48 @@
+#include <math.h>
+#include <esp8266.h>
+
+#include "curve.h"
+
+uint16_t dimmer_curve_table[DIMMER_CURVE_STEPS];
+
+/* fraction of full power delivered when firing at angle a (0..pi) */
+static double phase_cut_power(double a) {
+    return 1.0 - a / M_PI + sin(2.0 * a) / (2.0 * M_PI);
+}
+
+/* firing angle delivering the given power fraction, by bisection */
+static double phase_cut_angle(double power) {
+    double lo = 0.0, hi = M_PI;
+    for (int i = 0; i < 32; i++) {
+        double mid = (lo + hi) / 2.0;
+        /* power decreases with angle */
+        if (phase_cut_power(mid) > power) lo = mid; else hi = mid;
+    }
+    return (lo + hi) / 2.0;
+}
+
+/* CIE 1976 lightness L* (0..100) to relative luminance */
+static double lightness_to_luminance(double l) {
+    if (l > 8.0) return pow((l + 16.0) / 116.0, 3.0);
+    return l / 903.3;
+}
+
+void dimmer_curve_init(dimmer_curve_t curve) {
+    for (int b = 0; b < DIMMER_CURVE_STEPS; b++) {
+        double fraction;
+        switch (curve) {
+        case dimmer_curve_power_linear:
+            fraction = phase_cut_angle(b / 100.0) / M_PI;
+            break;
+        case dimmer_curve_perceptual:
+            fraction = phase_cut_angle(lightness_to_luminance(b)) / M_PI;
+            break;
+        case dimmer_curve_phase_linear:
+        default:
+            fraction = 1.0 - b / 100.0;
+            break;
+        }
+        fraction = fraction * 65536.0 + 0.5;
+        dimmer_curve_table[b] = (fraction >= 65535.0) ? 0xFFFF : (uint16_t)fraction;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Brightness to firing delay curves for phase-cut (leading edge) dimming.
+
+    Firing at angle a (0..pi) into a half-wave delivers a fraction
+    1 - a/pi + sin(2a)/(2pi) of full power, which is flat near both ends.
+    The table maps brightness 0..100 to the firing delay as a fraction of
+    the half-period, so the ISR only needs a lookup and a multiply with the
+    measured half-period.
+*/
+
+typedef enum {
+    /* delay proportional to 100 - brightness, as before */
+    dimmer_curve_phase_linear = 0,
+    /* delivered power proportional to brightness */
+    dimmer_curve_power_linear,
+    /* delivered power follows CIE lightness, brightness is perceived lightness */
+    dimmer_curve_perceptual,
+} dimmer_curve_t;
+
+#define DIMMER_CURVE_STEPS 101
+
+/* firing delay per brightness, in 1/65536 of the half-period */
+extern uint16_t dimmer_curve_table[DIMMER_CURVE_STEPS];
+
+/**
+    Fills dimmer_curve_table; uses floating point, call from task context.
+
+    @param curve The curve to generate
+*/
+void dimmer_curve_init(dimmer_curve_t curve);
+
+/**
+    @param brightness Brightness 0..100
+    @param half_period_us The measured mains half-period
+    @return Firing delay after the zero-crossing in microseconds
+*/
+static inline uint32_t dimmer_curve_delay_us(int brightness, uint32_t half_period_us) {
+    return (dimmer_curve_table[brightness] * half_period_us) >> 16;
+}
@@ -599,6 +599,53 @@
     .value = HOMEKIT_STRING_(text), \
     ##__VA_ARGS__
 
+#define HOMEKIT_SERVICE_CUSTOM_DIAGNOSTICS HOMEKIT_CUSTOM_UUID("F00000FE")
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_MAINS_FREQUENCY HOMEKIT_CUSTOM_UUID("F0000301")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_MAINS_FREQUENCY(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_MAINS_FREQUENCY, \
+    .description = "Mains frequency (Hz)", \
+    .format = homekit_format_float, \
+    .permissions = homekit_permissions_paired_read, \
+    .min_value = (float[]) {0}, \
+    .max_value = (float[]) {100}, \
+    .min_step = (float[]) {0.01}, \
+    .value = HOMEKIT_FLOAT_(_value), \
+    ##__VA_ARGS__
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_GLITCH_RATE HOMEKIT_CUSTOM_UUID("F0000302")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_GLITCH_RATE(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_GLITCH_RATE, \
+    .description = "Glitches per second", \
+    .format = homekit_format_float, \
+    .permissions = homekit_permissions_paired_read, \
+    .min_value = (float[]) {0}, \
+    .max_value = (float[]) {100000}, \
+    .min_step = (float[]) {0.1}, \
+    .value = HOMEKIT_FLOAT_(_value), \
+    ##__VA_ARGS__
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_ISR_LATENCY HOMEKIT_CUSTOM_UUID("F0000303")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_ISR_LATENCY(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_ISR_LATENCY, \
+    .description = "Worst ISR latency (us)", \
+    .format = homekit_format_float, \
+    .permissions = homekit_permissions_paired_read, \
+    .min_value = (float[]) {0}, \
+    .max_value = (float[]) {100000}, \
+    .min_step = (float[]) {0.1}, \
+    .value = HOMEKIT_FLOAT_(_value), \
+    ##__VA_ARGS__
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_MISSED_FIRINGS HOMEKIT_CUSTOM_UUID("F0000304")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_MISSED_FIRINGS(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_MISSED_FIRINGS, \
+    .description = "Missed firings", \
+    .format = homekit_format_uint32, \
+    .permissions = homekit_permissions_paired_read, \
+    .value = HOMEKIT_UINT32_(_value), \
+    ##__VA_ARGS__
+
 #define HOMEKIT_CHARACTERISTIC_CUSTOM_BOOLTEST HOMEKIT_CUSTOM_UUID("A0000001")
 #define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_BOOLTEST(_value, ...) \
     .type = HOMEKIT_CHARACTERISTIC_CUSTOM_BOOLTEST, \
@@ -0,0 +1,38 @@
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "zerocross.h"
+#include "triac.h"
+#include "diag.h"
+
+static diag_snapshot_t snapshot;
+static TickType_t snapshot_ticks;
+static uint32_t snapshot_glitches;
+static bool snapshot_valid;
+
+const diag_snapshot_t *diag_snapshot(void) {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - snapshot_ticks;
+    zerocross_stats_t zc_stats;
+    triac_stats_t triac_stats;
+
+    if (snapshot_valid && (elapsed < pdMS_TO_TICKS(DIAG_REFRESH_MS)))
+        return &snapshot;
+
+    zerocross_get_stats(&zc_stats);
+    triac_get_stats(&triac_stats);
+
+    snapshot.mains_hz = zerocross_locked() ? 500000.0f / zerocross_half_period_us() : 0;
+    if (snapshot_valid) {
+        snapshot.glitch_rate = (float)(zc_stats.glitches - snapshot_glitches) /
+            (elapsed * portTICK_PERIOD_MS) * 1000;
+    }
+    snapshot.latency_us = triac_stats.late_max_us;
+    snapshot.missed = triac_stats.missed;
+
+    snapshot_glitches = zc_stats.glitches;
+    snapshot_ticks = now;
+    snapshot_valid = true;
+
+    return &snapshot;
+}
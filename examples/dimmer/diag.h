@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Dimmer diagnostics for the custom HomeKit service.
+
+    The zero-cross and triac interrupts only ever bump their own 32-bit
+    counters. A snapshot reads them word by word, without a critical
+    section, and derives rates from the difference to the previous
+    snapshot. Snapshots are taken at most once per DIAG_REFRESH_MS however
+    often HomeKit reads, so polling has no effect on the firing path.
+*/
+
+#define DIAG_REFRESH_MS     1000
+
+typedef struct _diag_snapshot {
+    /* measured mains frequency, 0 until locked */
+    float mains_hz;
+    /* zero-cross edges rejected as glitches, per second */
+    float glitch_rate;
+    /* worst timer event lateness since start-up */
+    float latency_us;
+    /* gate pulses that did not happen before the next zero-crossing */
+    uint32_t missed;
+} diag_snapshot_t;
+
+/**
+    Returns the current snapshot, refreshing it if it is older than
+    DIAG_REFRESH_MS; call from task context.
+*/
+const diag_snapshot_t *diag_snapshot(void);
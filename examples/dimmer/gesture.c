@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "gesture.h"
+
+typedef enum {
+    STATE_IDLE,
+    STATE_PRESSED,
+    STATE_GAP,
+    STATE_HELD,
+    STATE_COUNT
+} gesture_state_t;
+
+typedef enum {
+    INPUT_PRESS,
+    INPUT_RELEASE,
+    INPUT_TIMEOUT,
+    INPUT_COUNT
+} gesture_input_t;
+
+typedef enum {
+    ACTION_NONE,
+    ACTION_COUNT_CLICK,
+    ACTION_CLICK,
+    ACTION_HOLD,
+    ACTION_REPEAT,
+    ACTION_RELEASE,
+} gesture_action_t;
+
+static const struct {
+    uint8_t next;
+    uint8_t action;
+} transitions[STATE_COUNT][INPUT_COUNT] = {
+    [STATE_IDLE] = {
+        [INPUT_PRESS]   = { STATE_PRESSED, ACTION_NONE },
+        [INPUT_RELEASE] = { STATE_IDLE,    ACTION_NONE },
+        [INPUT_TIMEOUT] = { STATE_IDLE,    ACTION_NONE },
+    },
+    [STATE_PRESSED] = {
+        [INPUT_PRESS]   = { STATE_PRESSED, ACTION_NONE },
+        [INPUT_RELEASE] = { STATE_GAP,     ACTION_COUNT_CLICK },
+        [INPUT_TIMEOUT] = { STATE_HELD,    ACTION_HOLD },
+    },
+    [STATE_GAP] = {
+        [INPUT_PRESS]   = { STATE_PRESSED, ACTION_NONE },
+        [INPUT_RELEASE] = { STATE_GAP,     ACTION_NONE },
+        [INPUT_TIMEOUT] = { STATE_IDLE,    ACTION_CLICK },
+    },
+    [STATE_HELD] = {
+        [INPUT_PRESS]   = { STATE_HELD,    ACTION_NONE },
+        [INPUT_RELEASE] = { STATE_IDLE,    ACTION_RELEASE },
+        [INPUT_TIMEOUT] = { STATE_HELD,    ACTION_REPEAT },
+    },
+};
+
+void gesture_init(gesture_t *gesture, const gesture_config_t *config) {
+    uint16_t sample_ms = config->sample_ms ? config->sample_ms : 1;
+
+    memset(gesture, 0, sizeof(*gesture));
+    gesture->config = config;
+    /* rounded up, a timeout of 0 never expires */
+    gesture->timeout[STATE_PRESSED] = (config->hold_ms + sample_ms - 1) / sample_ms;
+    gesture->timeout[STATE_GAP] = (config->gap_ms + sample_ms - 1) / sample_ms;
+    gesture->timeout[STATE_HELD] = (config->repeat_ms + sample_ms - 1) / sample_ms;
+}
+
+bool gesture_sample(gesture_t *gesture, bool pressed, gesture_event_t *event) {
+    gesture_input_t input;
+    uint16_t timeout;
+    uint8_t action;
+
+    gesture->ticks++;
+    if (pressed)
+        gesture->press_ticks++;
+
+    if (pressed != gesture->pressed) {
+        input = pressed ? INPUT_PRESS : INPUT_RELEASE;
+        gesture->pressed = pressed;
+    } else {
+        timeout = gesture->timeout[gesture->state];
+        if (!timeout || (gesture->ticks < timeout))
+            return false;
+        input = INPUT_TIMEOUT;
+    }
+
+    action = transitions[gesture->state][input].action;
+    gesture->state = transitions[gesture->state][input].next;
+    gesture->ticks = 0;
+    if (input == INPUT_PRESS)
+        gesture->press_ticks = 1;
+
+    switch (action) {
+    case ACTION_COUNT_CLICK:
+        gesture->clicks++;
+        if (!gesture->config->max_clicks || (gesture->clicks < gesture->config->max_clicks))
+            return false;
+        /* no need to wait for another click */
+        gesture->state = STATE_IDLE;
+        event->type = GESTURE_CLICK;
+        break;
+    case ACTION_CLICK:
+        event->type = GESTURE_CLICK;
+        break;
+    case ACTION_HOLD:
+        event->type = GESTURE_HOLD;
+        break;
+    case ACTION_REPEAT:
+        event->type = GESTURE_REPEAT;
+        break;
+    case ACTION_RELEASE:
+        event->type = GESTURE_RELEASE;
+        break;
+    default:
+        return false;
+    }
+
+    event->clicks = gesture->clicks;
+    event->held_ms = gesture->press_ticks * gesture->config->sample_ms;
+    /* the clicks before a hold stay with its repeats and release */
+    if ((action != ACTION_HOLD) && (action != ACTION_REPEAT))
+        gesture->clicks = 0;
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifdef LATENCY_TRACE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <xtensa/hal.h>
+
+#include "latency.h"
+
+static const char *stage_names[LATENCY_STAGES + 1] = {
+    [LATENCY_EDGE] = "edge",
+    [LATENCY_DEBOUNCED] = "debounce",
+    [LATENCY_CALLBACK] = "callback",
+    [LATENCY_OUTPUT] = "output",
+    [LATENCY_LED] = "led task",
+    [LATENCY_NOTIFIED] = "notify",
+    [LATENCY_STAGES] = "total",
+};
+
+/* the last one is the total, edge to notification */
+static latency_histogram_t histograms[LATENCY_STAGES + 1];
+
+/* cycle counter at the first edge, and at the last mark of the trace */
+static volatile uint32_t edge_ccount;
+static volatile bool edge_armed;
+static uint32_t trace_edge;
+static uint32_t trace_last;
+/* last stage of the trace, LATENCY_EDGE while none is open */
+static latency_stage_t trace_stage;
+
+static void latency_add(latency_histogram_t *histogram, uint32_t us) {
+    int bucket = us ? 31 - __builtin_clz(us) : 0;
+
+    if (bucket >= LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS - 1;
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum_us += us;
+    if (us > histogram->max_us)
+        histogram->max_us = us;
+}
+
+IRAM void latency_mark(latency_stage_t stage) {
+    uint32_t now = xthal_get_ccount();
+    uint32_t us;
+
+    if (stage == LATENCY_EDGE) {
+        /* the first edge of a bouncing transition */
+        if (!edge_armed) {
+            edge_ccount = now;
+            edge_armed = true;
+        }
+        return;
+    }
+
+    if (stage == LATENCY_DEBOUNCED) {
+        if (!edge_armed)
+            return;
+        /* a new trace, replacing one still open */
+        trace_edge = trace_last = edge_ccount;
+        trace_stage = LATENCY_EDGE;
+        edge_armed = false;
+    } else if ((trace_stage == LATENCY_EDGE) || (stage <= trace_stage)) {
+        return;
+    }
+
+    us = (now - trace_last) / sdk_system_get_cpu_freq();
+    if (us >= LATENCY_MAX_US) {
+        /* not caused by this trace */
+        trace_stage = LATENCY_EDGE;
+        return;
+    }
+    latency_add(&histograms[stage], us);
+    trace_last = now;
+    trace_stage = stage;
+
+    if (stage == LATENCY_NOTIFIED) {
+        latency_add(&histograms[LATENCY_STAGES], (now - trace_edge) / sdk_system_get_cpu_freq());
+        trace_stage = LATENCY_EDGE;
+    }
+}
+
+void latency_cancel(void) {
+    edge_armed = false;
+}
+
+void latency_get_histogram(latency_stage_t stage, latency_histogram_t *histogram) {
+    memcpy(histogram, &histograms[stage], sizeof(*histogram));
+}
+
+void latency_dump(void) {
+    latency_histogram_t histogram;
+    int stage, i;
+
+    for (stage = LATENCY_DEBOUNCED; stage <= LATENCY_STAGES; stage++) {
+        latency_get_histogram(stage, &histogram);
+        printf("latency %-8s %4u traces, mean %7uus, max %7uus:",
+            stage_names[stage], histogram.count,
+            histogram.count ? (uint32_t)(histogram.sum_us / histogram.count) : 0,
+            histogram.max_us);
+        /* only the buckets in use, by their lower bound */
+        for (i = 0; i < LATENCY_BUCKETS; i++) {
+            if (histogram.buckets[i])
+                printf(" %uus:%u", i ? 1U << i : 0, histogram.buckets[i]);
+        }
+        printf("\n");
+    }
+}
+
+#endif
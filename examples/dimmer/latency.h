@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Input-to-actuation latency tracing, built with LATENCY_TRACE (Makefile).
+
+    A trace follows one button transition through the firmware. The
+    button interrupt timestamps the first edge with the CPU cycle counter,
+    the debouncer marks its decision, and the callback, the output write,
+    the LED flash task and the HomeKit notification mark theirs. Each mark
+    adds the time since the previous one to the histogram of its stage;
+    the histograms have power-of-two buckets in microseconds.
+
+    A trace counts each stage once and only in order, so hold repeats and
+    outputs switched from HomeKit do not add to it. A mark more than
+    LATENCY_MAX_US after the previous one ends the trace instead. Traces
+    follow one input at a time, without locking: a mark racing another
+    may be lost, which is fine for statistics.
+
+    Without LATENCY_TRACE the LATENCY_MARK() calls compile to nothing.
+*/
+
+typedef enum {
+    /* first edge at the button interrupt, starts a trace */
+    LATENCY_EDGE,
+    /* debounced state changed, from the edge */
+    LATENCY_DEBOUNCED,
+    /* button or gesture callback called, from the debounced change */
+    LATENCY_CALLBACK,
+    /* relay or triac output written */
+    LATENCY_OUTPUT,
+    /* LED flash task created */
+    LATENCY_LED,
+    /* homekit_characteristic_notify() returned, also ends the trace */
+    LATENCY_NOTIFIED,
+    LATENCY_STAGES
+} latency_stage_t;
+
+/* bucket n counts latencies in [2^n, 2^(n+1)) us, the last one above */
+#define LATENCY_BUCKETS     22
+#define LATENCY_MAX_US      (1U << LATENCY_BUCKETS)
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+#ifdef LATENCY_TRACE
+
+#define LATENCY_MARK(stage) latency_mark(stage)
+
+/**
+    Records stage of the current trace, the edge from interrupt context.
+*/
+void latency_mark(latency_stage_t stage);
+
+/**
+    Drops a trace that ended without a debounced change (a glitch).
+*/
+void latency_cancel(void);
+
+/**
+    Latencies of stage since start-up, or from edge to notification for
+    LATENCY_STAGES.
+*/
+void latency_get_histogram(latency_stage_t stage, latency_histogram_t *histogram);
+
+/**
+    Prints all stage histograms.
+*/
+void latency_dump(void);
+
+#else
+
+#define LATENCY_MARK(stage) do {} while (0)
+
+static inline void latency_cancel(void) {}
+static inline void latency_dump(void) {}
+
+#endif
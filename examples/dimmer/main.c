@@ -36,12 +36,20 @@
 #include <wifi_config.h>
 #include <rboot-api.h>
 #include <stdout_redirect.h>
+#include <xtensa/hal.h>
 
 /* from RavenCore */
 #include "custom_characteristics.h"
 /* from LifeCycleManager */
 #include "udplogger.h"
 #include "button.h"
+#include "zerocross.h"
+#include "curve.h"
+#include "triac.h"
+#include "relay.h"
+#include "diag.h"
+#include "latency.h"
+#include "input.h"
 
 // The GPIO pin that is connected to the relay on the Sonoff Basic.
 const int relay_gpio = 12;
@@ -61,7 +69,19 @@ const int triac_gpio = 1;
 
 int enable_ota_after_powerup_press = 1;
 
-void button_callback(uint8_t gpio, bool button_is_pressed, uint32_t period);
+void button_gesture(uint8_t gpio, const gesture_event_t *event);
+
+/* click toggles, click-then-hold dims, double click prints diagnostics,
+   holding 2..5s, 5..10s or longer resets, see README */
+const gesture_config_t button_gestures = {
+    .sample_ms = BUTTON_SAMPLE_MS,
+    .hold_ms = 1000,
+    .gap_ms = 300,
+    .repeat_ms = 100,
+    .max_clicks = 2,
+};
+/* brightness change per repeat while dimming by hold */
+#define DIM_STEP 2
 
 void led_write(bool on) {
     //gpio_write(led_gpio, on ? 0 : 1);
@@ -74,9 +94,13 @@ void led_flash_task(void *_args) {
     vTaskDelete(NULL);
 }
 
+int mains_relay = -1;
+
+/* switched at a zero-crossing once the detector is locked, see relay.h */
 void relay_write(bool on) {
-    gpio_write(relay_gpio, on ? 1 : 0);
+    relay_set(mains_relay, on);
     xTaskCreate(led_flash_task, "LED flash", 128, NULL, 2, NULL);
+    LATENCY_MARK(LATENCY_LED);
     printf("relay o%s\n", on? "n": "ff");
 }
 
@@ -122,52 +146,144 @@ void reset_configuration(uint32_t flags) {
     xTaskCreate(reset_configuration_task, "Reset configuration", 256, (void *)&flags_static, 2, NULL);
 }
 
-/* brightness get and set */
-int g_brightness = 100;
-homekit_value_t light_bri_get() { return HOMEKIT_INT(g_brightness); }
-void light_bri_set(homekit_value_t value) {
+/* dimmer_curve_phase_linear, dimmer_curve_power_linear or dimmer_curve_perceptual */
+#define BRIGHTNESS_CURVE dimmer_curve_power_linear
+
+/* number of dimmed lights sharing the zero-cross detector, up to TRIAC_MAX_CHANNELS */
+#ifndef DIMMER_CHANNELS
+#define DIMMER_CHANNELS 1
+#endif
+#if DIMMER_CHANNELS > TRIAC_MAX_CHANNELS
+#error "DIMMER_CHANNELS exceeds TRIAC_MAX_CHANNELS"
+#endif
+/* duration of brightness and on/off transitions */
+#define DIMMER_FADE_MS 500
+/* the relay opens this long after the last light went off, once the fade
+   to off has reached zero; a few half-cycles more for the scheduler */
+#define DIMMER_RELAY_OFF_MS (DIMMER_FADE_MS + 30)
+/* how late the zero-cross detector fires after the real crossing */
+#ifndef DIMMER_DETECTOR_LAG_US
+#define DIMMER_DETECTOR_LAG_US 0
+#endif
+/* gate output per light; the first is the R16 wire on GPIO13, see README */
+const uint8_t dimmer_gpio[TRIAC_MAX_CHANNELS] = { 13, 14, 4, 5 };
+
+typedef struct {
+    int triac;
+    bool on;
+    int brightness;
+} light_t;
+
+light_t lights[DIMMER_CHANNELS];
+
+TimerHandle_t relay_off_timer;
+
+bool lights_any_on() {
+    bool any_on = false;
+
+    for (int i = 0; i < DIMMER_CHANNELS; i++) any_on |= lights[i].on;
+    return any_on;
+}
+
+/* timer task: the relay feeds all dimmed lights, keep it closed while any
+   is on; it opens only from relay_off_timer, after the fade to off */
+void relay_update(void *_args, uint32_t fade_done) {
+    static bool relay_on;
+    bool any_on = lights_any_on();
+
+    if ((any_on == relay_on) || (!any_on && !fade_done)) return;
+    relay_on = any_on;
+    relay_write(relay_on);
+}
+
+void relay_off_callback(TimerHandle_t timer) {
+    relay_update(NULL, true);
+}
+
+/* the triac fades at once; the relay closes at once, or opens once the
+   fade is done; both relay changes run on the timer task, in order */
+void light_update(light_t *light) {
+    triac_channel_set(light->triac, light->on, light->brightness);
+    LATENCY_MARK(LATENCY_OUTPUT);
+    if (lights_any_on()) {
+        xTimerStop(relay_off_timer, 0);
+        xTimerPendFunctionCall(relay_update, NULL, false, 0);
+    } else {
+        xTimerReset(relay_off_timer, 0);
+    }
+}
+
+/* brightness set */
+void light_bri_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    light_t *light = context;
     if (value.format != homekit_format_int) {
         printf("Invalid bri-value format: %d\n", value.format);
         return;
     }
-    g_brightness = value.int_value;
-    printf("brightness: %d\n", value.int_value);
+    if ((value.int_value < 0) || (value.int_value > 100)) {
+        printf("Invalid bri-value: %d\n", value.int_value);
+        return;
+    }
+    light->brightness = value.int_value;
+    light_update(light);
+    printf("brightness %d: %d\n", (int)(light - lights), value.int_value);
 }
 
-/* light get and set */
-bool g_on;
-
-homekit_value_t light_on_get(void);
-void light_on_set(homekit_value_t value);
-homekit_characteristic_t lightbulb_on = HOMEKIT_CHARACTERISTIC_(ON, false, .getter=light_on_get, .setter=light_on_set);
-
-homekit_value_t light_on_get() { return HOMEKIT_BOOL(g_on); }
-void light_on_set(homekit_value_t value) {
+/* light set */
+void light_on_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    light_t *light = context;
     if (value.format != homekit_format_bool) {
         printf("Invalid on-value format: %d\n", value.format);
         return;
     }
-    relay_write(value.bool_value);
-    g_on = value.bool_value;
-    printf("light on: %d\n", (int)value.bool_value);
+    light->on = value.bool_value;
+    light_update(light);
+    printf("light %d on: %d\n", (int)(light - lights), (int)value.bool_value);
 }
 
+#define LIGHTBULB_ON(n) \
+    HOMEKIT_CHARACTERISTIC_(ON, false, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_on_callback, .context=&lights[n]))
 
-static int zerocrossing_triggered = 0;
-static int timer_count = 0;
-static void IRAM frc1_interrupt_handler(void *arg)
-{
-    timer_count++;
-    timer_set_run(FRC1, false);
+homekit_characteristic_t lightbulb_on[DIMMER_CHANNELS] = {
+    LIGHTBULB_ON(0),
+#if DIMMER_CHANNELS > 1
+    LIGHTBULB_ON(1),
+#endif
+#if DIMMER_CHANNELS > 2
+    LIGHTBULB_ON(2),
+#endif
+#if DIMMER_CHANNELS > 3
+    LIGHTBULB_ON(3),
+#endif
+};
 
-    gpio_write(triac_gpio, 0);
-    gpio_write(2, 1);
-    gpio_write(led_gpio, 1);
-    zerocrossing_triggered = 0;
+#define LIGHTBULB_BRIGHTNESS(n) \
+    HOMEKIT_CHARACTERISTIC_(BRIGHTNESS, 100, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_bri_callback, .context=&lights[n]))
+
+homekit_characteristic_t lightbulb_brightness[DIMMER_CHANNELS] = {
+    LIGHTBULB_BRIGHTNESS(0),
+#if DIMMER_CHANNELS > 1
+    LIGHTBULB_BRIGHTNESS(1),
+#endif
+#if DIMMER_CHANNELS > 2
+    LIGHTBULB_BRIGHTNESS(2),
+#endif
+#if DIMMER_CHANNELS > 3
+    LIGHTBULB_BRIGHTNESS(3),
+#endif
+};
+
+/* after a brightness change made on the device */
+void light_brightness_notify(int n) {
+    lightbulb_brightness[n].value = HOMEKIT_INT(lights[n].brightness);
+    homekit_characteristic_notify(&lightbulb_brightness[n], lightbulb_brightness[n].value);
+    LATENCY_MARK(LATENCY_NOTIFIED);
 }
 
-static int zerocross_irq_count = 0;
-static int zerocross_count = 0;
+#ifdef TRIAC_TIMING
+/* zero-cross interrupts rejected as flank bounces, and accepted crossings */
+triac_cycles_t bounce_cycles, crossing_cycles;
+#endif
 
 /* called on each positive edge of the zero-cross detector
  *
@@ -181,102 +297,158 @@ static int zerocross_count = 0;
  * same flank. Thus we must only act on the first trigger condition
  * for each interval, otherwise jitter and randomness occurs.
  * 
- * Reset the trigger condition once we have handled the interval
- * through the timer
+ * The zero-cross tracker timestamps each edge and rejects all edges
+ * within a holdoff window after the first one, sized from the measured
+ * half-period.
+ *
+ * On the first edge, the triac scheduler drops all gates and chains FRC1
+ * through the firing times of all dimmed lights for this half-cycle.
  */
-void zerocross_intr_callback(uint8_t gpio) {
-    /* count each interrupt */
-    zerocross_irq_count++;
+IRAM void zerocross_intr_callback(uint8_t gpio) {
+    uint32_t now = xthal_get_ccount();
 
-#if 0
-    /* ignore if already triggered */
-    if (zerocrossing_triggered == 1) return;
-#endif
-    zerocross_count++;
-
-    if (g_on && (g_brightness == 100)) {
-        gpio_write(triac_gpio, 0);
-        gpio_write(2, 1);
-        gpio_write(led_gpio, 1);
-        return;
-    }
-    else if (!g_on || (g_brightness == 0)) {
-        gpio_write(triac_gpio, 1);
-        gpio_write(2, 0);
-        gpio_write(led_gpio, 0);
+    /* ignore the rest of the flank */
+    if (!zerocross_tracker_edge(now)) {
+        TRIAC_CYCLES(&bounce_cycles, now);
         return;
     }
 
-    zerocrossing_triggered++;
-    if ((zerocrossing_triggered == 1) || 0/*(zerocrossing_triggered == 100)*/) {
-#if 1
-        /* short pulse on each zero-crossing*/
-        gpio_write(triac_gpio, 1);
-        gpio_write(2, 0);
-        gpio_write(led_gpio, 0);
-#endif
-        timer_set_divider(FRC1, TIMER_CLKDIV_16);
-        uint32_t interval_us = 7500;
-        interval_us = 10000 - (((g_brightness * 10000/*10ms(100Hz)*/) + 50) / 100);
-        /* single shot timer */
-        uint32_t count = timer_time_to_count(FRC1, interval_us, TIMER_CLKDIV_16);
-        //timer_set_timeout(FRC1, 6000/*6 ms*/);
-        timer_set_load(FRC1, count);
-        timer_set_reload(FRC1, false);
-        timer_set_run(FRC1, true);
-    }
+    /* fire against the measured half-period, 10ms (50Hz) or 8.3ms (60Hz) */
+    relay_zerocross(now, zerocross_half_period_us());
+    triac_zerocross(zerocross_half_period_us());
+    TRIAC_CYCLES(&crossing_cycles, now);
 }
 
+#ifdef RELAY_SENSE_GPIO
+/* filtered load voltage behind the relay, teaches the relay its delays */
+IRAM void relay_sense_intr_callback(uint8_t gpio) {
+    relay_sensed(mains_relay, gpio_read(RELAY_SENSE_GPIO), xthal_get_ccount());
+}
+#endif
+
 void gpio_init() {
     gpio_enable(led_gpio, GPIO_OUTPUT);
     led_write(false);
 
-    gpio_enable(relay_gpio, GPIO_OUTPUT);
-    relay_write(lightbulb_on.value.bool_value);
-#if 1
-    gpio_enable(triac_gpio, GPIO_OUTPUT);
-    gpio_write(triac_gpio, 0);
+    mains_relay = relay_create(relay_gpio, false);
+    relay_write(false);
+    relay_off_timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(DIMMER_RELAY_OFF_MS), pdFALSE/*reload*/, 0, relay_off_callback);
+#ifdef RELAY_SENSE_GPIO
+    gpio_enable(RELAY_SENSE_GPIO, GPIO_INPUT);
+    gpio_set_interrupt(RELAY_SENSE_GPIO, GPIO_INTTYPE_EDGE_ANY, relay_sense_intr_callback);
+#endif
 
-    gpio_enable(2, GPIO_OUTPUT);
-    gpio_write(2, 0);
+    dimmer_curve_init(BRIGHTNESS_CURVE);
+    triac_init();
+    triac_set_fade(DIMMER_FADE_MS);
+    triac_set_lag(DIMMER_DETECTOR_LAG_US);
+    for (int i = 0; i < DIMMER_CHANNELS; i++) {
+        lights[i].brightness = 100;
+        lights[i].triac = triac_channel_create(dimmer_gpio[i], false);
+    }
+#ifdef DIMMER_DEBUG_PINS
+    /* the first light's gate also on GPIO2, and inverted on triac_gpio */
+    triac_channel_mirror(lights[0].triac, 2, false);
+    triac_channel_mirror(lights[0].triac, triac_gpio, true);
 
     //gpio_set_pullup(triac_gpio, true, true);
 #endif
 #if 1
+    zerocross_tracker_init();
     gpio_enable(zerocross_gpio, GPIO_INPUT);
     gpio_set_interrupt(zerocross_gpio, GPIO_INTTYPE_EDGE_POS, zerocross_intr_callback);
 #endif
-
-    _xt_isr_attach(INUM_TIMER_FRC1, frc1_interrupt_handler, NULL);
-    timer_set_reload(FRC1, false);
-    timer_set_interrupts(FRC1, true);
-    timer_set_run(FRC1, false);
 }
 
-void button_callback(uint8_t gpio, bool button_is_pressed, uint32_t pressed_period) {
-    if (button_is_pressed) {
-      printf("button is still being pressed for %ums\n", pressed_period);
-      return;
+void print_diagnostics(void) {
+    zerocross_stats_t zc_stats;
+    zerocross_get_stats(&zc_stats);
+    triac_stats_t triac_stats;
+    triac_get_stats(&triac_stats);
+    printf("zero-cross count: %u/%u, glitches: %u, timer_count: %u, missed: %u, late: %uus\n",
+        zc_stats.crossings, zc_stats.irq_count, zc_stats.glitches,
+        triac_stats.timer_count, triac_stats.missed, triac_stats.late_max_us);
+    printf("mains: %uHz, half-period %uus, %slocked\n", zerocross_mains_hz(), zerocross_half_period_us(), zerocross_locked() ? "" : "un");
+    uint32_t close_us, open_us;
+    relay_stats_t relay_stats;
+    relay_get_delays(mains_relay, &close_us, &open_us);
+    relay_get_stats(&relay_stats);
+    printf("relay: close %uus, open %uus, %u synchronized, %u immediate, %u learned\n",
+        close_us, open_us, relay_stats.synchronized, relay_stats.immediate, relay_stats.learned);
+    udplog_stats_t log_stats;
+    udplog_get_stats(&log_stats);
+    printf("udplog: %u bytes, %u writes dropped (%u bytes), %u truncated, %u waiting at most\n",
+        log_stats.written, log_stats.dropped, log_stats.dropped_bytes, log_stats.truncated,
+        log_stats.max_used);
+#ifdef TRIAC_TIMING
+    triac_cycles_t cycles[3];
+    const char *handler[3] = { "bounce", "crossing", "gate" };
+    triac_cycles_get(&bounce_cycles, &cycles[0]);
+    triac_cycles_get(&crossing_cycles, &cycles[1]);
+    triac_get_gate_cycles(&cycles[2]);
+    for (int i = 0; i < 3; i++) {
+        printf("isr cycles, %s: %u runs, min %u, avg %u, max %u\n", handler[i], cycles[i].count,
+            cycles[i].min, cycles[i].count ? (uint32_t)(cycles[i].sum / cycles[i].count) : 0, cycles[i].max);
     }
-    printf("button was kept pressed for %ums and now released.\n", pressed_period);
-    if ((pressed_period > 100) && (pressed_period < 1000)) {
-        if (enable_ota_after_powerup_press) {
-            printf("Request OTA Update.\n");
+#endif
+    latency_dump();
+}
+
+void button_gesture(uint8_t gpio, const gesture_event_t *event) {
+    static int dim_direction = 1;
+    light_t *light = &lights[0];
+
+    switch (event->type) {
+    case GESTURE_CLICK:
+        printf("button clicked %u times.\n", event->clicks);
+        if (event->clicks == 1) {
+            if (enable_ota_after_powerup_press) {
+                printf("Request OTA Update.\n");
+            }
+            printf("Toggling light.\n");
+            lightbulb_on[0].value.bool_value = !lightbulb_on[0].value.bool_value;
+            light->on = lightbulb_on[0].value.bool_value;
+            light_update(light);
+            homekit_characteristic_notify(&lightbulb_on[0], lightbulb_on[0].value);
+            LATENCY_MARK(LATENCY_NOTIFIED);
+        } else {
+            print_diagnostics();
         }
-        printf("Toggling relay.\n");
-        lightbulb_on.value.bool_value = !lightbulb_on.value.bool_value;
-        g_on = lightbulb_on.value.bool_value;
-        relay_write(lightbulb_on.value.bool_value);
-        homekit_characteristic_notify(&lightbulb_on, lightbulb_on.value);
-    } else
-    if ((pressed_period > 2000) && (pressed_period <= 5000)) {
-        reset_configuration(FLAG_UPDATE_OTA);
-    } else if ((pressed_period > 5000) && (pressed_period <= 10000)) {
-        reset_configuration(FLAG_RESET_HOMEKIT);
-    } else if (pressed_period > 10000) {
-        reset_configuration(FLAG_RESET_WIFI | FLAG_RESET_HOMEKIT | FLAG_UPDATE_OTA);
+        break;
+    case GESTURE_HOLD:
+        if (event->clicks != 1) break;
+        /* dim by holding after a click, reversing direction every time */
+        dim_direction = (light->brightness >= 100) ? -1 : (light->brightness <= 1) ? 1 : -dim_direction;
+        if (!light->on) {
+            lightbulb_on[0].value.bool_value = light->on = true;
+            light_update(light);
+            homekit_characteristic_notify(&lightbulb_on[0], lightbulb_on[0].value);
+            LATENCY_MARK(LATENCY_NOTIFIED);
+        }
+        break;
+    case GESTURE_REPEAT:
+        if (event->clicks == 1) {
+            light->brightness += dim_direction * DIM_STEP;
+            if (light->brightness > 100) light->brightness = 100;
+            if (light->brightness < 1) light->brightness = 1;
+            light_update(light);
+        } else if ((event->held_ms % 1000) == 0) {
+            printf("button is still being pressed for %ums\n", event->held_ms);
+        }
+        break;
+    case GESTURE_RELEASE:
+        printf("button was kept pressed for %ums and now released.\n", event->held_ms);
+        if (event->clicks == 1) {
+            light_brightness_notify(0);
+        } else if ((event->held_ms > 2000) && (event->held_ms <= 5000)) {
+            reset_configuration(FLAG_UPDATE_OTA);
+        } else if ((event->held_ms > 5000) && (event->held_ms <= 10000)) {
+            reset_configuration(FLAG_RESET_HOMEKIT);
+        } else if (event->held_ms > 10000) {
+            reset_configuration(FLAG_RESET_WIFI | FLAG_RESET_HOMEKIT | FLAG_UPDATE_OTA);
+        }
+        break;
     }
-    printf("zero-cross count: %u/%u, timer_count: %u\n", zerocross_count, zerocross_irq_count, timer_count);
 }
 
 void switch_identify_task(void *_args) {
@@ -315,6 +487,45 @@ void ota_firmware_callback() {
 
 homekit_characteristic_t setup_service_name = HOMEKIT_CHARACTERISTIC_(NAME, "Setup", .id=100);
 
+/* diagnostics, read from snapshots refreshed at most once per second */
+homekit_value_t diag_mains_hz_get() { return HOMEKIT_FLOAT(diag_snapshot()->mains_hz); }
+homekit_value_t diag_glitch_rate_get() { return HOMEKIT_FLOAT(diag_snapshot()->glitch_rate); }
+homekit_value_t diag_latency_get() { return HOMEKIT_FLOAT(diag_snapshot()->latency_us); }
+homekit_value_t diag_missed_get() { return HOMEKIT_UINT32(diag_snapshot()->missed); }
+
+/* button wired to be pressed at high level, saved in flash, see input.h */
+homekit_value_t reverse_sw1_get() {
+    bool inverted, pullup;
+
+    input_config_get(button_gpio, &inverted, &pullup);
+    return HOMEKIT_BOOL(inverted);
+}
+
+void reverse_sw1_set(homekit_value_t value) {
+    bool inverted, pullup;
+
+    if (value.format != homekit_format_bool) {
+        printf("Invalid reverse-value format: %d\n", value.format);
+        return;
+    }
+    input_config_get(button_gpio, &inverted, &pullup);
+    if (input_config_set(button_gpio, value.bool_value, pullup)) {
+        printf("Failed to save button configuration\n");
+    }
+}
+
+homekit_characteristic_t diag_service_name = HOMEKIT_CHARACTERISTIC_(NAME, "Diagnostics");
+
+#define LIGHTBULB_SERVICE(n, name) \
+        HOMEKIT_SERVICE(LIGHTBULB, .primary=(n == 0), \
+            .characteristics=(homekit_characteristic_t*[]){ \
+                HOMEKIT_CHARACTERISTIC(NAME, name), \
+                &lightbulb_on[n], \
+                &lightbulb_brightness[n], \
+                NULL \
+            } \
+        )
+
 homekit_accessory_t *accessories[] = {
     HOMEKIT_ACCESSORY(.id=1, .category=homekit_accessory_category_switch, .services=(homekit_service_t*[]){
         HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]){
@@ -326,24 +537,33 @@ homekit_accessory_t *accessories[] = {
             HOMEKIT_CHARACTERISTIC(IDENTIFY, switch_identify),
             NULL
         }),
-        HOMEKIT_SERVICE(LIGHTBULB, .primary=true,
-            .characteristics=(homekit_characteristic_t*[]){
-                HOMEKIT_CHARACTERISTIC(NAME, "Sonoff Dimmer"),
-                &lightbulb_on,
-                HOMEKIT_CHARACTERISTIC(BRIGHTNESS, 100, .getter=light_bri_get, .setter=light_bri_set),
-                NULL
-            }
-        ),
+        LIGHTBULB_SERVICE(0, "Sonoff Dimmer"),
+#if DIMMER_CHANNELS > 1
+        LIGHTBULB_SERVICE(1, "Sonoff Dimmer 2"),
+#endif
+#if DIMMER_CHANNELS > 2
+        LIGHTBULB_SERVICE(2, "Sonoff Dimmer 3"),
+#endif
+#if DIMMER_CHANNELS > 3
+        LIGHTBULB_SERVICE(3, "Sonoff Dimmer 4"),
+#endif
+        HOMEKIT_SERVICE(CUSTOM_DIAGNOSTICS, .primary=false, .characteristics=(homekit_characteristic_t*[]){
+            &diag_service_name,
+            HOMEKIT_CHARACTERISTIC(CUSTOM_MAINS_FREQUENCY, 0, .getter=diag_mains_hz_get),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_GLITCH_RATE, 0, .getter=diag_glitch_rate_get),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_ISR_LATENCY, 0, .getter=diag_latency_get),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_MISSED_FIRINGS, 0, .getter=diag_missed_get),
+            NULL
+        }),
+        /* writable settings, apart from the read-only diagnostics */
+        HOMEKIT_SERVICE(CUSTOM_SETUP, .primary=false, .characteristics=(homekit_characteristic_t*[]){
+            &setup_service_name,
 #if 0
-            .type = HOMEKIT_SERVICE_CUSTOM_SETUP,
-            .primary=false,
-            .characteristics=(homekit_characteristic_t*[]){
-                &setup_service_name,
-                &ota_firmware,
-                NULL
-            }
-        ,
+            &ota_firmware,
 #endif
+            HOMEKIT_CHARACTERISTIC(CUSTOM_REVERSE_SW1, false, .getter=reverse_sw1_get, .setter=reverse_sw1_set),
+            NULL
+        }),
         /* zero terminate services */
         NULL
     }),
@@ -360,7 +580,7 @@ void on_wifi_ready() {
     /* capture with: sudo tcpdump -i enp3s0 udp port 45678 -v -X */
 
     UDPLOG("on_wifi_ready(); redirecting printf() to udplog_writer\n");
-    xTaskCreate(udplog_send, "logsend", 256, NULL, 4/*prio*/, NULL);
+    xTaskCreate(udplog_send, "logsend", 512, NULL, 1/*prio*/, NULL);
     set_write_stdout(udplog_write);
 
     //set_write_stdout(NULL);
@@ -417,7 +637,8 @@ void user_init(void) {
 #endif
     gpio_init();
 
-    if (button_create(button_gpio, 0, button_callback)) {
+    if (button_create(button_gpio, 0, NULL) ||
+        button_set_gestures(button_gpio, &button_gestures, button_gesture)) {
         printf("Failed to initialize button\n");
     }
 
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp8266.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+#include <espressif/esp_system.h>
+#include <xtensa/hal.h>
+#include <sysparam.h>
+
+#include "zerocross.h"
+#include "triac.h"
+#include "relay.h"
+
+/* the coil edge is not placed closer than this to the crossing */
+#define LEAD_MIN_US         50
+/* sensed changes later than this after the coil edge are not ours */
+#define DELAY_MAX_US        30000
+/* new measurements move the delay by 1/4 */
+#define FILTER_SHIFT        2
+/* write to flash only when the delay moved this much since the last save */
+#define SAVE_THRESHOLD_US   100
+/* a switch not timed by a crossing within a few half-periods is made at
+   once, as mains or the detector went away after the lock check */
+#define FALLBACK_MS         50
+
+typedef struct _relay {
+    uint8_t gpio_num;
+    bool active_low;
+    /* last requested state, and whether it still has to be driven */
+    volatile bool on;
+    volatile bool pending;
+    /* a coil edge was queued at the last crossing; triac_zerocross() drops
+       it if the next crossing comes first, so pending stays set until the
+       coil output shows the switch */
+    volatile bool queued;
+    /* coil edge of the last switch, to measure the delay against */
+    uint32_t drive_ccount;
+    volatile bool sensing;
+    /* learned and last saved delays, us */
+    volatile uint32_t delay_us[2];
+    uint32_t saved_us[2];
+    /* whether delay_us was measured (or loaded) rather than a default */
+    bool learned[2];
+    /* a measurement to write to flash from the timer task */
+    volatile bool save_due;
+    /* one-shot, for the fallback switch and the save */
+    TimerHandle_t timer;
+} relay_t;
+
+static relay_t relays[RELAY_MAX];
+static uint8_t relay_count;
+static uint32_t cycles_per_us;
+static relay_stats_t stats;
+
+/* sysparam keys, one per relay and direction */
+static void relay_key(char *key, int relay, bool on) {
+    sprintf(key, "relay%d.%s_us", relay, on ? "close" : "open");
+}
+
+static void relay_load(int relay) {
+    char key[24];
+    int32_t value;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        relay_key(key, relay, i);
+        if ((sysparam_get_int32(key, &value) == SYSPARAM_OK) && (value > 0) && (value < DELAY_MAX_US)) {
+            relays[relay].delay_us[i] = value;
+            relays[relay].learned[i] = true;
+        }
+        relays[relay].saved_us[i] = relays[relay].delay_us[i];
+    }
+}
+
+static void relay_save(int relay) {
+    char key[24];
+    uint32_t delay;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        delay = relays[relay].delay_us[i];
+        if ((delay + SAVE_THRESHOLD_US > relays[relay].saved_us[i]) &&
+            (delay < relays[relay].saved_us[i] + SAVE_THRESHOLD_US))
+            continue;
+        relay_key(key, relay, i);
+        if (sysparam_set_int32(key, delay) == SYSPARAM_OK) {
+            relays[relay].saved_us[i] = delay;
+            printf("relay %d: %s delay %uus saved\n", relay, i ? "close" : "open", delay);
+        }
+    }
+}
+
+static void relay_drive(relay_t *relay, bool on) {
+    gpio_write(relay->gpio_num, on != relay->active_low);
+}
+
+static bool relay_driven(relay_t *relay) {
+    return gpio_read(relay->gpio_num) == (relay->on != relay->active_low);
+}
+
+/* no mains timing to aim at */
+static void relay_drive_now(relay_t *relay) {
+    relay_drive(relay, relay->on);
+    relay->drive_ccount = xthal_get_ccount();
+    relay->sensing = true;
+    stats.immediate++;
+}
+
+static void relay_timer_callback(TimerHandle_t timer) {
+    relay_t *relay = pvTimerGetTimerID(timer);
+    bool late;
+
+    /* not if the zero-cross interrupt took it meanwhile */
+    taskENTER_CRITICAL();
+    late = relay->pending;
+    relay->pending = false;
+    /* the queued edge may have been made after all */
+    if (late && relay->queued && relay_driven(relay))
+        stats.synchronized++;
+    else if (late)
+        relay_drive_now(relay);
+    relay->queued = false;
+    taskEXIT_CRITICAL();
+
+    if (relay->save_due) {
+        relay->save_due = false;
+        relay_save(relay - relays);
+    }
+}
+
+int relay_create(uint8_t gpio_num, bool active_low) {
+    relay_t *relay;
+
+    if ((relay_count >= RELAY_MAX) || (gpio_num > 15))
+        return -1;
+
+    cycles_per_us = sdk_system_get_cpu_freq();
+    relay = &relays[relay_count];
+    memset(relay, 0, sizeof(*relay));
+    relay->gpio_num = gpio_num;
+    relay->active_low = active_low;
+    relay->delay_us[false] = RELAY_OPEN_US;
+    relay->delay_us[true] = RELAY_CLOSE_US;
+    relay->timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(FALLBACK_MS), pdFALSE/*reload*/, relay/*id*/, relay_timer_callback);
+    if (!relay->timer)
+        return -1;
+    relay_load(relay_count);
+
+    gpio_enable(gpio_num, GPIO_OUTPUT);
+    relay_drive(relay, false);
+
+    return relay_count++;
+}
+
+void relay_set(int relay, bool on) {
+    if ((relay < 0) || (relay >= relay_count))
+        return;
+
+    taskENTER_CRITICAL();
+    relays[relay].on = on;
+    relays[relay].queued = false;
+    relays[relay].pending = zerocross_locked();
+    if (!relays[relay].pending)
+        relay_drive_now(&relays[relay]);
+    taskEXIT_CRITICAL();
+
+    /* in case no crossing comes to time it */
+    if (relays[relay].pending)
+        xTimerReset(relays[relay].timer, 0);
+}
+
+IRAM void relay_zerocross(uint32_t ccount, uint32_t half_period_us) {
+    uint32_t delay, lead, lag = triac_get_lag();
+    int i;
+
+    for (i = 0; i < relay_count; i++) {
+        relay_t *relay = &relays[i];
+        bool on = relay->on;
+
+        if (!relay->pending) continue;
+        if (relay->queued && relay_driven(relay)) {
+            relay->pending = false;
+            relay->queued = false;
+            stats.synchronized++;
+            continue;
+        }
+
+        /* drive the coil delay before a later real crossing, which comes
+           lag before a detected one, in this half-cycle; an edge too close
+           to either crossing is moved by up to LEAD_MIN_US */
+        delay = relay->delay_us[on] + lag;
+        lead = half_period_us - (delay % half_period_us);
+        if (lead >= half_period_us) lead = LEAD_MIN_US;
+        if (lead < LEAD_MIN_US) lead = LEAD_MIN_US;
+        if (lead > half_period_us - LEAD_MIN_US) lead = half_period_us - LEAD_MIN_US;
+
+        if (triac_output_once(relay->gpio_num, on != relay->active_low, lead) < 0) continue;
+        relay->queued = true;
+        relay->drive_ccount = ccount + lead * cycles_per_us;
+        relay->sensing = true;
+    }
+}
+
+IRAM void relay_sensed(int relay, bool present, uint32_t ccount) {
+    BaseType_t woken = pdFALSE;
+    uint32_t measured;
+    bool on;
+
+    if ((relay < 0) || (relay >= relay_count) || !relays[relay].sensing)
+        return;
+    on = relays[relay].on;
+    if (present != on)
+        return;
+
+    /* a change before the coil edge belongs to the previous switch */
+    if ((int32_t)(ccount - relays[relay].drive_ccount) < 0)
+        return;
+    relays[relay].sensing = false;
+
+    measured = (ccount - relays[relay].drive_ccount) / cycles_per_us;
+    if (measured >= DELAY_MAX_US)
+        return;
+
+    /* the first measurement replaces the default outright */
+    if (relays[relay].learned[on]) {
+        relays[relay].delay_us[on] += ((int32_t)measured - (int32_t)relays[relay].delay_us[on]) >> FILTER_SHIFT;
+    } else {
+        relays[relay].delay_us[on] = measured;
+        relays[relay].learned[on] = true;
+    }
+    stats.learned++;
+
+    /* flash is written from the timer task */
+    relays[relay].save_due = true;
+    xTimerResetFromISR(relays[relay].timer, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void relay_get_delays(int relay, uint32_t *close_us, uint32_t *open_us) {
+    if ((relay < 0) || (relay >= relay_count)) {
+        *close_us = *open_us = 0;
+        return;
+    }
+    *close_us = relays[relay].delay_us[true];
+    *open_us = relays[relay].delay_us[false];
+}
+
+void relay_get_stats(relay_stats_t *stats_out) {
+    *stats_out = stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Zero-cross synchronized relay switching.
+
+    A relay's contacts move a fixed mechanical delay after the coil is
+    driven, typically 5..10ms to close and less to open. On every accepted
+    zero-crossing a pending switch is turned into a one-shot coil output on
+    the triac timer, placed so that the contacts meet (or break) exactly at
+    a later crossing. This avoids arcing and the inrush peak of capacitive
+    LED drivers.
+
+    The delays are learned when the board can see the load side: call
+    relay_sensed() whenever a (filtered, not per half-cycle) load voltage
+    signal changes. Any lag of that signal adds to both learned delays.
+    Learned delays are stored in flash (sysparam) per relay, from the timer
+    task after each measurement, and loaded again at start-up.
+
+    The zero-cross detector must be on the supply side of the relay; while
+    it is not locked, relays switch immediately. A switch that no crossing
+    has timed a few half-periods after relay_set() is made immediately too.
+    The coil edge is queued again at every crossing until the output shows
+    it, as triac_zerocross() drops edges a crossing overtakes. The detector
+    lag set with triac_set_lag() is taken into account.
+*/
+
+#define RELAY_MAX           2
+
+/* defaults until learned */
+#ifndef RELAY_CLOSE_US
+#define RELAY_CLOSE_US      8000
+#endif
+#ifndef RELAY_OPEN_US
+#define RELAY_OPEN_US       4000
+#endif
+
+typedef struct _relay_stats {
+    /* switches timed against a zero-crossing */
+    uint32_t synchronized;
+    /* switches made immediately, without a locked zero-cross or after
+       no crossing came to time them */
+    uint32_t immediate;
+    /* delay measurements taken by relay_sensed() */
+    uint32_t learned;
+} relay_stats_t;
+
+/**
+    Sets up a relay output; it starts open. The learned delays are loaded
+    from flash, keyed by the relay index.
+
+    @param gpio_num Coil output on GPIO0..15
+    @param active_low Whether the coil is driven with a low level
+    @return Relay index, -1 if all relays are in use or gpio_num is invalid
+*/
+int relay_create(uint8_t gpio_num, bool active_low);
+
+/**
+    Requests the relay to close or open; the coil is driven from the next
+    zero-crossing. Call from a task.
+*/
+void relay_set(int relay, bool on);
+
+/**
+    Schedules pending switches for the half-cycle that just started; to be
+    called from the zero-cross interrupt before triac_zerocross().
+
+    @param ccount CPU cycle counter at the zero-crossing
+    @param half_period_us The measured mains half-period
+*/
+void relay_zerocross(uint32_t ccount, uint32_t half_period_us);
+
+/**
+    Reports a change of the load voltage behind a relay; the first change
+    that matches the last switch measures its mechanical delay. May be
+    called from an interrupt.
+
+    @param relay Relay index
+    @param present Whether the load voltage is now present
+    @param ccount CPU cycle counter when the change was seen
+*/
+void relay_sensed(int relay, bool present, uint32_t ccount);
+
+/**
+    @param relay Relay index
+    @param close_us Receives the close delay in microseconds
+    @param open_us Receives the open delay in microseconds
+*/
+void relay_get_delays(int relay, uint32_t *close_us, uint32_t *open_us);
+
+/**
+    @param stats Receives the switch counters of all relays
+*/
+void relay_get_stats(relay_stats_t *stats);
@@ -0,0 +1,350 @@
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <xtensa/hal.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "curve.h"
+#include "triac.h"
+
+#define TRIAC_TIMER_DIV     TIMER_CLKDIV_16
+/* FRC1 runs from the 80MHz APB clock whatever the CPU clock is */
+#define TRIAC_COUNTS_PER_US (80 / 16)
+
+/* firing delay as a fraction of the half-period, 1/65536 */
+#define POSITION_FULL_ON    0
+#define POSITION_OFF        65536
+
+typedef struct _triac_channel {
+    /* registers to write while the gate is on */
+    uint32_t on_set;
+    uint32_t on_clear;
+    /* set by triac_channel_set(), picked up at the next zero-crossing */
+    volatile uint32_t target;
+    volatile bool retarget;
+    /* faded towards target by step every half-cycle */
+    uint32_t position;
+    uint32_t step;
+} triac_channel_t;
+
+typedef struct _triac_event {
+    /* time after the zero-crossing */
+    uint32_t time_us;
+    /* timer count from the previous event (or the zero-crossing) */
+    uint32_t count;
+    /* CPU cycle counter the event is due at */
+    uint32_t due;
+    uint32_t set;
+    uint32_t clear;
+    /* gates raised by this event */
+    uint8_t fires;
+} triac_event_t;
+
+static triac_channel_t channels[TRIAC_MAX_CHANNELS];
+static uint8_t channel_count;
+
+/* one gate-on and one gate-off event per channel, plus one-shot outputs */
+static triac_event_t events[2 * TRIAC_MAX_CHANNELS + TRIAC_MAX_ONCE];
+static uint8_t event_count;
+static uint8_t event_next;
+
+/* queued by triac_output_once() for the next zero-crossing */
+static triac_event_t once[TRIAC_MAX_ONCE];
+static volatile uint8_t once_count;
+
+static uint32_t cycles_per_us;
+static uint32_t fade_us;
+static uint32_t lag_us;
+
+/* written by the interrupts only, read word by word by triac_get_stats() */
+static uint32_t timer_count;
+static uint32_t missed;
+static uint32_t late_max_cycles;
+
+#ifdef TRIAC_TIMING
+static triac_cycles_t gate_cycles;
+
+IRAM void triac_cycles_add(triac_cycles_t *cycles, uint32_t start) {
+    uint32_t taken = xthal_get_ccount() - start;
+
+    if (!cycles->count || (taken < cycles->min)) cycles->min = taken;
+    if (taken > cycles->max) cycles->max = taken;
+    cycles->sum += taken;
+    cycles->count++;
+}
+
+void triac_cycles_get(const triac_cycles_t *cycles, triac_cycles_t *result) {
+    taskENTER_CRITICAL();
+    *result = *cycles;
+    taskEXIT_CRITICAL();
+}
+#endif
+
+static IRAM void triac_timer_interrupt_handler(void *arg) {
+    triac_event_t *event;
+#ifdef TRIAC_TIMING
+    uint32_t start = xthal_get_ccount();
+#endif
+
+    timer_count++;
+    if (event_next >= event_count) {
+        timer_set_run(FRC1, false);
+        return;
+    }
+
+    event = &events[event_next++];
+    GPIO.OUT_SET = event->set;
+    GPIO.OUT_CLEAR = event->clear;
+
+    uint32_t late = xthal_get_ccount() - event->due;
+    if ((int32_t)late > (int32_t)late_max_cycles) late_max_cycles = late;
+
+    if (event_next < event_count) {
+        timer_set_load(FRC1, events[event_next].count);
+    } else {
+        timer_set_run(FRC1, false);
+    }
+    TRIAC_CYCLES(&gate_cycles, start);
+}
+
+/* append an event, merging it into the previous one if they are close */
+static IRAM void triac_event_add(uint32_t time_us, uint32_t set, uint32_t clear, uint8_t fires) {
+    triac_event_t *event;
+
+    if (event_count && (time_us - events[event_count - 1].time_us < TRIAC_COALESCE_US)) {
+        event = &events[event_count - 1];
+        event->set |= set;
+        event->clear |= clear;
+        event->fires += fires;
+        return;
+    }
+    event = &events[event_count++];
+    event->time_us = time_us;
+    event->set = set;
+    event->clear = clear;
+    event->fires = fires;
+}
+
+/* insert an event in time order, merging it into a neighbour if close */
+static IRAM void triac_event_insert(uint32_t time_us, uint32_t set, uint32_t clear) {
+    triac_event_t *event;
+    uint8_t i = event_count, j;
+
+    while (i && (events[i - 1].time_us > time_us)) i--;
+    if (i && (time_us - events[i - 1].time_us < TRIAC_COALESCE_US)) {
+        event = &events[i - 1];
+    } else if ((i < event_count) && (events[i].time_us - time_us < TRIAC_COALESCE_US)) {
+        event = &events[i];
+    } else {
+        for (j = event_count; j > i; j--) {
+            events[j] = events[j - 1];
+        }
+        event_count++;
+        event = &events[i];
+        event->time_us = time_us;
+        event->set = 0;
+        event->clear = 0;
+        event->fires = 0;
+    }
+    event->set |= set;
+    event->clear |= clear;
+}
+
+IRAM void triac_zerocross(uint32_t half_period_us) {
+    uint32_t delay_us[TRIAC_MAX_CHANNELS];
+    uint8_t order[TRIAC_MAX_CHANNELS];
+    uint32_t set = 0, clear = 0, previous_us;
+    uint8_t i, j, fire, release, dimmed = 0;
+    uint32_t now = xthal_get_ccount();
+
+    /* whatever is left of the previous half-cycle is dropped */
+    timer_set_run(FRC1, false);
+    for (i = event_next; i < event_count; i++) {
+        missed += events[i].fires;
+    }
+    event_count = 0;
+    event_next = 0;
+
+    for (i = 0; i < channel_count; i++) {
+        triac_channel_t *channel = &channels[i];
+        uint32_t target = channel->target;
+
+        /* advance the fade by one half-cycle */
+        if (channel->retarget) {
+            uint32_t distance = (target > channel->position) ?
+                (target - channel->position) : (channel->position - target);
+            uint32_t half_cycles = fade_us / half_period_us;
+            channel->retarget = false;
+            channel->step = half_cycles ? (distance / half_cycles) : distance;
+            if (!channel->step) channel->step = 1;
+        }
+        if (channel->position < target) {
+            channel->position = (target - channel->position > channel->step) ?
+                (channel->position + channel->step) : target;
+        } else if (channel->position > target) {
+            channel->position = (channel->position - target > channel->step) ?
+                (channel->position - channel->step) : target;
+        }
+
+        if (channel->position == POSITION_FULL_ON) {
+            /* held on */
+            set |= channel->on_set;
+            clear |= channel->on_clear;
+            continue;
+        }
+        /* gate off until fired */
+        set |= channel->on_clear;
+        clear |= channel->on_set;
+        if (channel->position >= POSITION_OFF) continue;
+
+        /* after the detected crossing, which is lag_us late; a gate pulse
+           reaching the next crossing would conduct the whole half-cycle */
+        uint32_t delay = (channel->position * half_period_us) >> 16;
+        delay = (delay > lag_us) ? (delay - lag_us) : 0;
+        if (delay + TRIAC_GATE_US + lag_us + TRIAC_MARGIN_US > half_period_us) continue;
+
+        /* insertion sort by firing delay, at most TRIAC_MAX_CHANNELS */
+        for (j = dimmed; j && (delay_us[j - 1] > delay); j--) {
+            delay_us[j] = delay_us[j - 1];
+            order[j] = order[j - 1];
+        }
+        delay_us[j] = delay;
+        order[j] = i;
+        dimmed++;
+    }
+    GPIO.OUT_SET = set;
+    GPIO.OUT_CLEAR = clear;
+
+    /* merge the gate-on and gate-off sequences, both in delay order */
+    fire = 0;
+    release = 0;
+    while (release < dimmed) {
+        if ((fire < dimmed) && (delay_us[fire] <= delay_us[release] + TRIAC_GATE_US)) {
+            triac_channel_t *channel = &channels[order[fire]];
+            triac_event_add(delay_us[fire], channel->on_set, channel->on_clear, 1);
+            fire++;
+        } else {
+            triac_channel_t *channel = &channels[order[release]];
+            triac_event_add(delay_us[release] + TRIAC_GATE_US, channel->on_clear, channel->on_set, 0);
+            release++;
+        }
+    }
+
+    for (i = 0; i < once_count; i++) {
+        triac_event_insert(once[i].time_us, once[i].set, once[i].clear);
+    }
+    once_count = 0;
+
+    if (!event_count) return;
+
+    /* relative timer loads, so the event interrupt only copies one */
+    previous_us = 0;
+    for (i = 0; i < event_count; i++) {
+        events[i].count = (events[i].time_us - previous_us) * TRIAC_COUNTS_PER_US;
+        if (!events[i].count) events[i].count = 1;
+        events[i].due = now + events[i].time_us * cycles_per_us;
+        previous_us = events[i].time_us;
+    }
+
+    timer_set_load(FRC1, events[0].count);
+    timer_set_run(FRC1, true);
+}
+
+void triac_init(void) {
+    memset(channels, 0, sizeof(channels));
+    channel_count = 0;
+    event_count = 0;
+    cycles_per_us = sdk_system_get_cpu_freq();
+
+    _xt_isr_attach(INUM_TIMER_FRC1, triac_timer_interrupt_handler, NULL);
+    timer_set_divider(FRC1, TRIAC_TIMER_DIV);
+    timer_set_reload(FRC1, false);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, false);
+}
+
+static void triac_channel_add_gpio(triac_channel_t *channel, uint8_t gpio_num, bool active_low) {
+    if (active_low) {
+        channel->on_clear |= BIT(gpio_num);
+    } else {
+        channel->on_set |= BIT(gpio_num);
+    }
+    gpio_enable(gpio_num, GPIO_OUTPUT);
+    gpio_write(gpio_num, active_low);
+}
+
+int triac_channel_create(uint8_t gpio_num, bool active_low) {
+    if ((channel_count >= TRIAC_MAX_CHANNELS) || (gpio_num > 15))
+        return -1;
+
+    channels[channel_count].target = POSITION_OFF;
+    channels[channel_count].position = POSITION_OFF;
+    triac_channel_add_gpio(&channels[channel_count], gpio_num, active_low);
+
+    return channel_count++;
+}
+
+int triac_channel_mirror(int channel, uint8_t gpio_num, bool active_low) {
+    if ((channel < 0) || (channel >= channel_count) || (gpio_num > 15))
+        return -1;
+
+    triac_channel_add_gpio(&channels[channel], gpio_num, active_low);
+
+    return 0;
+}
+
+void triac_channel_set(int channel, bool on, int brightness) {
+    if ((channel < 0) || (channel >= channel_count))
+        return;
+    if (brightness < 0) brightness = 0;
+    if (brightness > 100) brightness = 100;
+
+    if (!on || (brightness == 0)) {
+        channels[channel].target = POSITION_OFF;
+    } else if (brightness == 100) {
+        channels[channel].target = POSITION_FULL_ON;
+    } else {
+        channels[channel].target = dimmer_curve_table[brightness];
+    }
+    channels[channel].retarget = true;
+}
+
+IRAM int triac_output_once(uint8_t gpio_num, bool level, uint32_t delay_us) {
+    triac_event_t *event;
+
+    if ((once_count >= TRIAC_MAX_ONCE) || (gpio_num > 15))
+        return -1;
+
+    event = &once[once_count];
+    event->time_us = delay_us;
+    event->set = level ? BIT(gpio_num) : 0;
+    event->clear = level ? 0 : BIT(gpio_num);
+    once_count++;
+
+    return 0;
+}
+
+void triac_set_lag(uint32_t detector_lag_us) {
+    lag_us = detector_lag_us;
+}
+
+IRAM uint32_t triac_get_lag(void) {
+    return lag_us;
+}
+
+void triac_set_fade(uint32_t fade_ms) {
+    fade_us = fade_ms * 1000;
+}
+
+void triac_get_stats(triac_stats_t *stats) {
+    stats->timer_count = timer_count;
+    stats->missed = missed;
+    stats->late_max_us = late_max_cycles / cycles_per_us;
+}
+
+#ifdef TRIAC_TIMING
+void triac_get_gate_cycles(triac_cycles_t *gate) {
+    triac_cycles_get(&gate_cycles, gate);
+}
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Phase-cut firing scheduler for up to TRIAC_MAX_CHANNELS triacs sharing
+    one zero-cross detector and the FRC1 hardware timer.
+
+    On every zero-crossing the firing delays of all dimmed channels are
+    sorted and turned into a short list of timer events (gate on, gate off).
+    Events closer than TRIAC_COALESCE_US are merged into one interrupt.
+    FRC1 is chained through the list as one-shots, and each event interrupt
+    does a fixed amount of work. The gate pulse is TRIAC_GATE_US wide; the
+    triac itself stays latched until the next zero-crossing.
+
+    Level changes fade: every zero-crossing moves the firing delay of each
+    channel one step towards its target, so a fade spans a fixed number of
+    half-cycles and does not depend on any task being scheduled.
+
+    Gate outputs are driven through the GPIO set/clear registers and must
+    be on GPIO0..15.
+*/
+
+#define TRIAC_MAX_CHANNELS  4
+/* one-shot outputs per half-cycle, see triac_output_once() */
+#define TRIAC_MAX_ONCE      2
+
+/* fire events closer than this are served by one interrupt */
+#ifndef TRIAC_COALESCE_US
+#define TRIAC_COALESCE_US   20
+#endif
+/* gate pulse width */
+#ifndef TRIAC_GATE_US
+#define TRIAC_GATE_US       200
+#endif
+/* no gate pulse may reach closer than this to the next zero-crossing */
+#ifndef TRIAC_MARGIN_US
+#define TRIAC_MARGIN_US     300
+#endif
+
+typedef struct _triac_stats {
+    /* timer event interrupts served */
+    uint32_t timer_count;
+    /* gate pulses still pending at the next zero-crossing */
+    uint32_t missed;
+    /* worst lateness of a timer event against its time after the
+       zero-crossing interrupt, since start-up */
+    uint32_t late_max_us;
+} triac_stats_t;
+
+/**
+    Attaches the FRC1 interrupt; call once before creating channels.
+*/
+void triac_init(void);
+
+/**
+    Adds a dimmed output.
+
+    @param gpio_num The GPIO driving the triac gate
+    @param active_low Whether the gate is on when the GPIO is low
+    @return The channel number, or a negative integer if this method fails
+*/
+int triac_channel_create(uint8_t gpio_num, bool active_low);
+
+/**
+    Drives an additional GPIO with the gate signal of a channel, e.g. for a scope.
+
+    @param channel The channel number from triac_channel_create()
+    @param gpio_num The GPIO to mirror the gate on
+    @param active_low Whether the mirror is inverted
+    @return A negative integer if this method fails
+*/
+int triac_channel_mirror(int channel, uint8_t gpio_num, bool active_low);
+
+/**
+    Sets the level of a channel; the fade towards it starts at the next
+    zero-crossing.
+
+    @param channel The channel number from triac_channel_create()
+    @param on When false the gate never fires
+    @param brightness 0..100; 0 never fires, 100 keeps the gate on
+*/
+void triac_channel_set(int channel, bool on, int brightness);
+
+/**
+    Queues one output change at a fixed time after the next zero-crossing,
+    served by the same timer events as the gates; to be called from the
+    zero-cross interrupt, before triac_zerocross().
+
+    @param gpio_num Output on GPIO0..15, not a gate output
+    @param level Level to write
+    @param delay_us Time after the zero-crossing, less than a half-period
+    @return 0 on success, -1 if the queue is full or gpio_num is invalid
+*/
+int triac_output_once(uint8_t gpio_num, bool level, uint32_t delay_us);
+
+/**
+    Sets how late the zero-cross detector reports a crossing; firing delays
+    are shortened by it, so the angles count from the real crossing.
+    Firings that would then end within TRIAC_MARGIN_US of the next real
+    crossing are skipped, rather than moved towards it.
+
+    @param lag_us Detector delay in microseconds, less than a half-period
+*/
+void triac_set_lag(uint32_t lag_us);
+
+/**
+    The detector lag set by triac_set_lag(), for other outputs timed
+    against the crossings.
+*/
+uint32_t triac_get_lag(void);
+
+/**
+    Sets the duration of fades started by later triac_channel_set() calls.
+
+    @param fade_ms Fade duration in milliseconds, 0 switches immediately
+*/
+void triac_set_fade(uint32_t fade_ms);
+
+/**
+    Schedules the firing for the half-cycle that just started; to be
+    called from the zero-cross interrupt for every accepted crossing.
+
+    @param half_period_us The measured mains half-period
+*/
+void triac_zerocross(uint32_t half_period_us);
+
+/**
+    Reads the counters kept by the interrupts, each with one 32-bit load,
+    without disabling interrupts.
+
+    @param stats Receives the counters
+*/
+void triac_get_stats(triac_stats_t *stats);
+
+#ifdef TRIAC_TIMING
+/* CPU cycles of an interrupt handler, from its first to its last
+   instruction, since start-up; the dispatch before it is not included */
+typedef struct _triac_cycles {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} triac_cycles_t;
+
+#define TRIAC_CYCLES(cycles, start) triac_cycles_add((cycles), (start))
+
+/**
+    Adds one run of a handler that started at the cycle count start; to
+    be called from that interrupt.
+*/
+void triac_cycles_add(triac_cycles_t *cycles, uint32_t start);
+
+/**
+    Copies cycles, kept by an interrupt, with interrupts disabled.
+*/
+void triac_cycles_get(const triac_cycles_t *cycles, triac_cycles_t *result);
+
+/**
+    Cycles of the gate event interrupt.
+*/
+void triac_get_gate_cycles(triac_cycles_t *gate);
+#else
+#define TRIAC_CYCLES(cycles, start)
+#endif
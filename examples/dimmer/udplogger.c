@@ -2,6 +2,7 @@
 // (C) Copyright 2019 Leon 'likewise' Woestenberg
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <espressif/esp_wifi.h>
 #include <espressif/esp_sta.h>
 // //#include <espressif/esp_system.h> //for timestamp report only
@@ -15,14 +16,66 @@
 
 #include <udplogger.h>
 
-char udplogstring[2900]={0}; //in the end I do not know to prevent overflow, so I use the max size of 2 UDP packets ??
-int  udplogstring_len=0;
+#define UDPLOG_RING_MASK (UDPLOG_RING_SIZE - 1)
+_Static_assert((UDPLOG_RING_SIZE & UDPLOG_RING_MASK) == 0, "UDPLOG_RING_SIZE must be a power of two");
+
+/* send once this much is waiting, else UDPLOG_FLUSH_MS after the first write */
+#define UDPLOG_SEND_THRESHOLD 700
+/* at most one Ethernet frame per datagram */
+#define UDPLOG_PACKET_MAX 1400
+
+static char ring[UDPLOG_RING_SIZE];
+/* free running; head is only written by the writers, tail by udplog_send() */
+static volatile uint32_t ring_head, ring_tail;
+static udplog_stats_t stats;
+/* woken by the writers, once it is ready to send */
+static volatile TaskHandle_t sender;
+
+/* appends all of ptr or nothing, counting it as dropped if asked */
+static bool udplog_put(const void *ptr, size_t len, bool count) {
+    uint32_t head, used, offset, first;
+
+    /* one writer at a time, without blocking or masking interrupts */
+    vTaskSuspendAll();
+    head = ring_head;
+    used = head - ring_tail;
+    if (len > UDPLOG_RING_SIZE - used) {
+        if (count) {
+            stats.dropped++;
+            stats.dropped_bytes += len;
+        }
+        xTaskResumeAll();
+        return false;
+    }
+
+    offset = head & UDPLOG_RING_MASK;
+    first = UDPLOG_RING_SIZE - offset;
+    if (first > len)
+        first = len;
+    memcpy(ring + offset, ptr, first);
+    memcpy(ring, (const char *)ptr + first, len - first);
+    /* the bytes are in place before the reader can see them */
+    __sync_synchronize();
+    ring_head = head + len;
+
+    stats.written += len;
+    if (used + len > stats.max_used)
+        stats.max_used = used + len;
+    xTaskResumeAll();
+
+    /* the first bytes start the flush timeout, the threshold ends it */
+    if (sender && (!used || (used < UDPLOG_SEND_THRESHOLD && used + len >= UDPLOG_SEND_THRESHOLD)))
+        xTaskNotifyGive(sender);
+    return true;
+}
 
 void udplog_send(void *pvParameters){
-    int lSocket,i=0;
+    int lSocket;
     struct sockaddr_in sLocalAddr, sDestAddr;
+    uint32_t reported = 0, dropped, tail, used, chunk;
+    char line[64];
 
-    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) vTaskDelay(20); //Check if we have an IP every 200ms 
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) vTaskDelay(20); //Check if we have an IP every 200ms
 
     lSocket = lwip_socket(AF_INET, SOCK_DGRAM, 0);
     memset((char *)&sLocalAddr, 0, sizeof(sLocalAddr));
@@ -39,23 +92,69 @@ void udplog_send(void *pvParameters){
     sLocalAddr.sin_port = htons(44444);
     lwip_bind(lSocket, (struct sockaddr *)&sLocalAddr, sizeof(sLocalAddr));
 
+    /* whatever was written until now is sent in the first round */
+    sender = xTaskGetCurrentTaskHandle();
     while (1) {
-        if ((!i && udplogstring_len) || udplogstring_len>700) {
-            lwip_sendto(lSocket, udplogstring, udplogstring_len, 0, (struct sockaddr *)&sDestAddr, sizeof(sDestAddr));
-            udplogstring_len=0;
-            i=10;
+        dropped = stats.dropped;
+        if (dropped != reported) {
+            /* retried until it fits, not a drop itself */
+            snprintf(line, sizeof(line), "udplog: %u writes dropped\n", dropped - reported);
+            if (udplog_put(line, strlen(line), false))
+                reported = dropped;
+        }
+
+        /* sleeps until a write, then gathers more until the threshold or
+           the flush timeout; a notification left from the last round only
+           costs an early wakeup */
+        if (ring_head == ring_tail)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (ring_head - ring_tail < UDPLOG_SEND_THRESHOLD)
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UDPLOG_FLUSH_MS));
+
+        tail = ring_tail;
+        used = ring_head - tail;
+        while (used) {
+            /* up to the end of the ring, the rest in the next datagram */
+            chunk = UDPLOG_RING_SIZE - (tail & UDPLOG_RING_MASK);
+            if (chunk > used) chunk = used;
+            if (chunk > UDPLOG_PACKET_MAX) chunk = UDPLOG_PACKET_MAX;
+            lwip_sendto(lSocket, ring + (tail & UDPLOG_RING_MASK), chunk, 0, (struct sockaddr *)&sDestAddr, sizeof(sDestAddr));
+            tail += chunk;
+            used -= chunk;
+            /* done reading before the writers may reuse it */
+            __sync_synchronize();
+            ring_tail = tail;
         }
-        if (!i) i=10; //sends output every 100ms if not more than 700 bytes
-        i--;
-        vTaskDelay(1); //with len>1000 and delay=10ms, we might handle 800kbps throughput
     }
 }
 
 /* for stdout redirection */
 ssize_t udplog_write(struct _reent *r, int fd, const void *ptr, size_t len) {
-    if ((udplogstring_len + len) < 2900) {
-        memcpy(udplogstring+udplogstring_len,ptr,len);
-        udplogstring_len += len;
-    }
+    udplog_put(ptr, len, true);
     return len;
 }
+
+void udplog_printf(const char *format, ...) {
+    char buffer[128];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (len < 0)
+        return;
+    if (len >= sizeof(buffer)) {
+        len = sizeof(buffer) - 1;
+        vTaskSuspendAll();
+        stats.truncated++;
+        xTaskResumeAll();
+    }
+    udplog_put(buffer, len, true);
+}
+
+void udplog_get_stats(udplog_stats_t *result) {
+    vTaskSuspendAll();
+    memcpy(result, &stats, sizeof(*result));
+    xTaskResumeAll();
+}
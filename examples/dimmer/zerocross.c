@@ -0,0 +1,136 @@
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <xtensa/hal.h>
+
+#include "zerocross.h"
+
+/* accepted half-periods, 45..67Hz mains */
+#define HALF_PERIOD_MIN_US      7500
+#define HALF_PERIOD_MAX_US      11000
+/* 50Hz: 10000us, 60Hz: 8333us */
+#define HALF_PERIOD_50_60_US    9167
+#define HALF_PERIOD_NOMINAL_US  10000
+
+/* estimate in 1/16 us, filtered by 1/8 of each new measurement */
+#define ESTIMATE_SHIFT          4
+#define FILTER_SHIFT            3
+/* a measurement within this distance of the estimate is in lock */
+#define LOCK_TOLERANCE_US       150
+#define LOCK_COUNT              8
+#define UNLOCK_COUNT            4
+/* edges closer than this to the last crossing are glitches, in 1/4 */
+#define HOLDOFF_QUARTERS        3
+/* no edges for this many half-periods, e.g. detector or mains gone */
+#define STALE_HALF_PERIODS      4
+
+typedef struct _zerocross_tracker {
+    uint32_t cycles_per_us;
+    uint32_t last_edge;
+    bool have_last_edge;
+    /* edges closer than this to last_edge are glitches, CPU cycles */
+    uint32_t holdoff_cycles;
+    /* filtered half-period, 1/16 us */
+    uint32_t estimate;
+    uint8_t in_lock;
+    uint8_t out_of_lock;
+    bool locked;
+    zerocross_stats_t stats;
+} zerocross_tracker_t;
+
+static zerocross_tracker_t tracker;
+
+/* only recomputed when the estimate moves, not for every edge */
+static IRAM void zerocross_tracker_holdoff(void) {
+    tracker.holdoff_cycles = (zerocross_half_period_us() * HOLDOFF_QUARTERS / 4) * tracker.cycles_per_us;
+}
+
+void zerocross_tracker_init(void) {
+    memset(&tracker, 0, sizeof(tracker));
+    tracker.cycles_per_us = sdk_system_get_cpu_freq();
+    zerocross_tracker_holdoff();
+}
+
+static IRAM void zerocross_tracker_miss(void) {
+    tracker.in_lock = 0;
+    if (tracker.out_of_lock < UNLOCK_COUNT) tracker.out_of_lock++;
+    if (tracker.out_of_lock >= UNLOCK_COUNT) tracker.locked = false;
+}
+
+IRAM bool zerocross_tracker_edge(uint32_t ccount) {
+    uint32_t period_us;
+    int32_t error;
+
+    tracker.stats.irq_count++;
+
+    if (!tracker.have_last_edge) {
+        tracker.have_last_edge = true;
+        tracker.last_edge = ccount;
+        tracker.stats.crossings++;
+        return true;
+    }
+    /* still on the flank of the last crossing; most edges end here, so
+       this is a subtraction and a compare against a precomputed window.
+       The unsigned difference stays correct across counter wrap-around */
+    if (ccount - tracker.last_edge < tracker.holdoff_cycles) {
+        tracker.stats.glitches++;
+        return false;
+    }
+    period_us = (ccount - tracker.last_edge) / tracker.cycles_per_us;
+    tracker.last_edge = ccount;
+    tracker.stats.crossings++;
+
+    /* back after a gap that zerocross_locked() already reported: lock
+       again from scratch, the mains may have changed meanwhile */
+    if (period_us > STALE_HALF_PERIODS * zerocross_half_period_us()) {
+        tracker.locked = false;
+        tracker.in_lock = 0;
+    }
+    if ((period_us < HALF_PERIOD_MIN_US) || (period_us > HALF_PERIOD_MAX_US)) {
+        zerocross_tracker_miss();
+        return true;
+    }
+    if (!tracker.estimate) {
+        tracker.estimate = period_us << ESTIMATE_SHIFT;
+        zerocross_tracker_holdoff();
+        return true;
+    }
+
+    error = (int32_t)(period_us << ESTIMATE_SHIFT) - (int32_t)tracker.estimate;
+    if ((error <= (LOCK_TOLERANCE_US << ESTIMATE_SHIFT)) && (error >= -(LOCK_TOLERANCE_US << ESTIMATE_SHIFT))) {
+        tracker.out_of_lock = 0;
+        if (tracker.in_lock < LOCK_COUNT) tracker.in_lock++;
+        if (tracker.in_lock >= LOCK_COUNT) tracker.locked = true;
+    } else {
+        zerocross_tracker_miss();
+        /* once locked, outliers must not pull the estimate */
+        if (tracker.locked) return true;
+    }
+    tracker.estimate += error >> FILTER_SHIFT;
+    zerocross_tracker_holdoff();
+    return true;
+}
+
+IRAM uint32_t zerocross_half_period_us(void) {
+    if (!tracker.estimate) return HALF_PERIOD_NOMINAL_US;
+    return (tracker.estimate + (1 << (ESTIMATE_SHIFT - 1))) >> ESTIMATE_SHIFT;
+}
+
+bool zerocross_locked(void) {
+    /* read-only, the state belongs to the interrupt; a lock without
+       edges for a few half-periods is stale and reads as unlocked */
+    return tracker.locked && tracker.cycles_per_us &&
+        ((xthal_get_ccount() - tracker.last_edge) / tracker.cycles_per_us <= STALE_HALF_PERIODS * zerocross_half_period_us());
+}
+
+uint8_t zerocross_mains_hz(void) {
+    if (!tracker.estimate) return 0;
+    return (zerocross_half_period_us() > HALF_PERIOD_50_60_US) ? 50 : 60;
+}
+
+void zerocross_get_stats(zerocross_stats_t *stats) {
+    /* word by word, the interrupt may update the counters in between */
+    stats->irq_count = tracker.stats.irq_count;
+    stats->crossings = tracker.stats.crossings;
+    stats->glitches = tracker.stats.glitches;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Mains zero-cross tracker.
+
+    Every accepted zero-cross edge is timestamped with the CPU cycle counter.
+    The interval to the previous edge feeds a low-pass filtered half-period
+    estimate, from which the mains frequency (50/60Hz) is detected. The
+    tracker is locked once enough consecutive intervals agree with the
+    estimate, and unlocks again on repeated outliers or missing edges.
+
+    A slow detector flank fires the interrupt several times per crossing.
+    Edges within a holdoff window (3/4 of the measured half-period) after
+    an accepted crossing are rejected as glitches, so only the first edge
+    of each half-cycle is accepted.
+*/
+
+typedef struct _zerocross_stats {
+    /* raw zero-cross interrupts */
+    uint32_t irq_count;
+    /* accepted crossings, the first edge of each half-cycle */
+    uint32_t crossings;
+    /* edges rejected within the holdoff window */
+    uint32_t glitches;
+} zerocross_stats_t;
+
+/**
+    Resets the tracker; the half-period reads as nominal 50Hz until locked.
+*/
+void zerocross_tracker_init(void);
+
+/**
+    Feeds one zero-cross edge, to be called from the zero-cross interrupt.
+
+    @param ccount CPU cycle counter (xthal_get_ccount()) at the edge
+    @return true for the first edge of a half-cycle, false for a glitch
+*/
+bool zerocross_tracker_edge(uint32_t ccount);
+
+/**
+    @return The filtered mains half-period in microseconds
+*/
+uint32_t zerocross_half_period_us(void);
+
+/**
+    @return Whether the tracker is locked onto a stable mains frequency
+*/
+bool zerocross_locked(void);
+
+/**
+    @return The detected mains frequency, 50 or 60 Hz, or 0 if not yet measured
+*/
+uint8_t zerocross_mains_hz(void);
+
+/**
+    @param stats Receives the interrupt, crossing and glitch counters
+*/
+void zerocross_get_stats(zerocross_stats_t *stats);
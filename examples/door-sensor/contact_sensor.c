@@ -1,85 +1,148 @@
 #include <string.h>
-#include <etstimer.h>
+#include <stdlib.h>
 #include <esplibs/libmain.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
 #include "contact_sensor.h"
+#include "input.h"
 
 
 typedef struct _contact_sensor {
     uint8_t gpio_num;
     contact_sensor_callback_fn callback;
 
-    struct _contact_sensor *next;
+    // one-shot, restarted by every edge, expires once the contact is stable
+    TimerHandle_t timer;
+    volatile bool settling;
+    // edges since the window started, counted by the interrupt
+    volatile uint32_t window_edges;
+    // last reported state
+    contact_sensor_state_t state;
+    contact_sensor_stats_t stats;
 } contact_sensor_t;
 
+contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num) {
+    contact_sensor_t *sensor = input_find(gpio_num);
 
-contact_sensor_t *sensors = NULL;
+    // the last settled state while bouncing
+    if (sensor && sensor->settling)
+        return sensor->state;
+    return input_read(gpio_num);
+}
 
 
-static contact_sensor_t *contact_sensor_find_by_gpio(const uint8_t gpio_num) {
-    contact_sensor_t *sensor = sensors;
-    while (sensor && sensor->gpio_num != gpio_num)
-        sensor = sensor->next;
+// Timer task: the contact has not moved for the stability window, report
+// the settled state if it differs from the last one
+static void contact_sensor_timer_callback(TimerHandle_t timer) {
+    contact_sensor_t *sensor = pvTimerGetTimerID(timer);
+    contact_sensor_state_t state;
+    uint32_t edges;
 
-    return sensor;
-}
+    if (input_find(sensor->gpio_num) != sensor)
+        return;
 
-contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num) {
-    return gpio_read(gpio_num);
-}
+    taskENTER_CRITICAL();
+    sensor->settling = false;
+    edges = sensor->window_edges;
+    sensor->window_edges = 0;
+    taskEXIT_CRITICAL();
 
+    state = input_read(sensor->gpio_num);
+    if (state == sensor->state) {
+        // bounced back, or a glitch
+        sensor->stats.suppressed += edges;
+        return;
+    }
+    // the first edge made the change
+    if (edges)
+        sensor->stats.suppressed += edges - 1;
+    sensor->stats.changes++;
+    sensor->state = state;
+    sensor->callback(sensor->gpio_num, state);
+}
 
 void contact_sensor_intr_callback(uint8_t gpio) {
-    contact_sensor_t *sensor = contact_sensor_find_by_gpio(gpio);
+    BaseType_t woken = pdFALSE;
+    contact_sensor_t *sensor = input_find(gpio);
     if (!sensor)
         return;
 
-    sensor->callback(sensor->gpio_num, contact_sensor_state_get(sensor->gpio_num));
+    sensor->stats.edges++;
+    sensor->window_edges++;
+    sensor->settling = true;
+    xTimerResetFromISR(sensor->timer, &woken);
+    portYIELD_FROM_ISR(woken);
 }
 
 
 int contact_sensor_create(const uint8_t gpio_num, contact_sensor_callback_fn callback) {
-    contact_sensor_t *sensor = contact_sensor_find_by_gpio(gpio_num);
-    if (sensor)
+    if (input_find(gpio_num))
         return -1;
 
-    sensor = malloc(sizeof(contact_sensor_t));
+    contact_sensor_t *sensor = malloc(sizeof(contact_sensor_t));
     memset(sensor, 0, sizeof(*sensor));
     sensor->gpio_num = gpio_num;
     sensor->callback = callback;
+    sensor->timer = xTimerCreate(NULL/*name*/, pdMS_TO_TICKS(CONTACT_SENSOR_STABLE_MS), pdFALSE/*reload*/, sensor/*id*/, contact_sensor_timer_callback);
+    if (!sensor->timer) {
+        free(sensor);
+        return -1;
+    }
 
-    sensor->next = sensors;
-    sensors = sensor;
+    if (input_register(gpio_num, sensor)) {
+        xTimerDelete(sensor->timer, 0);
+        free(sensor);
+        return -1;
+    }
 
-    gpio_set_pullup(sensor->gpio_num, true, true);
+    input_configure(sensor->gpio_num, false);
+    sensor->state = input_read(sensor->gpio_num);
     gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, contact_sensor_intr_callback);
 
     return 0;
 }
 
 
-void contact_sensor_delete(const uint8_t gpio_num) {
-    if (!sensors)
-        return;
+int contact_sensor_set_stable_time(const uint8_t gpio_num, uint16_t stable_ms) {
+    contact_sensor_t *sensor = input_find(gpio_num);
+    if (!sensor)
+        return -1;
 
-    contact_sensor_t *sensor = NULL;
-    if (sensors->gpio_num == gpio_num) {
-        // Skip first element:
-        sensor = sensors;
-        sensors = sensors->next;
-    } else {
-        contact_sensor_t *b = sensors;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                // Unlink middle element:
-                sensor = b->next;
-                b->next = b->next->next;
-                break;
-            }
-        }
-    }
+    // at least one tick, so that the window does not end before the edge
+    if (xTimerChangePeriod(sensor->timer, pdMS_TO_TICKS(stable_ms) ? pdMS_TO_TICKS(stable_ms) : 1, 0) != pdPASS)
+        return -1;
+    // changing the period starts the timer, the window closes as usual
+    sensor->settling = true;
+    return 0;
+}
 
-    if (sensor) {
-        gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
-    }
+
+int contact_sensor_get_stats(const uint8_t gpio_num, contact_sensor_stats_t *stats) {
+    contact_sensor_t *sensor = input_find(gpio_num);
+    if (!sensor)
+        return -1;
+
+    memcpy(stats, &sensor->stats, sizeof(*stats));
+    return 0;
 }
 
+
+// Timer task, pended by contact_sensor_delete()
+static void contact_sensor_free(void *sensor, uint32_t unused) {
+    free(sensor);
+}
+
+void contact_sensor_delete(const uint8_t gpio_num) {
+    contact_sensor_t *sensor = input_find(gpio_num);
+    if (!sensor)
+        return;
+
+    gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+    input_unregister(gpio_num);
+    // the timer task works through its queue in order: an expiry queued
+    // before the delete still runs, finds the sensor unregistered and
+    // returns, and only then is the descriptor freed
+    xTimerDelete(sensor->timer, portMAX_DELAY);
+    xTimerPendFunctionCall(contact_sensor_free, sensor, 0, portMAX_DELAY);
+}
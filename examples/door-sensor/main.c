@@ -54,7 +54,7 @@ homekit_characteristic_t door_open_characteristic = HOMEKIT_CHARACTERISTIC_(CONT
 );
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the timer task once the contact settled in a new state, to notify the client of the change.
  **/
 void contact_sensor_callback(uint8_t gpio, contact_sensor_state_t state) {
     switch (state) {
@@ -66,6 +66,10 @@ void contact_sensor_callback(uint8_t gpio, contact_sensor_state_t state) {
         default:
             printf("Unknown contact sensor event: %d\n", state);
     }
+
+    contact_sensor_stats_t stats;
+    contact_sensor_get_stats(gpio, &stats);
+    printf("Contact sensor: %u edges, %u changes, %u bounces suppressed\n", stats.edges, stats.changes, stats.suppressed);
 }
 
 /**
@@ -115,7 +119,8 @@ void user_init(void) {
 
     wifi_init();
     printf("Using Sensor at GPIO%d.\n", REED_PIN);
-    if (contact_sensor_create(REED_PIN, contact_sensor_callback)) {
+    if (contact_sensor_create(REED_PIN, contact_sensor_callback) ||
+        contact_sensor_set_stable_time(REED_PIN, REED_STABLE_MS)) {
         printf("Failed to initialize door\n");
     }
     homekit_server_init(&config);
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <esplibs/libmain.h>
 #include "button_sensor.h"
+#include "input.h"
 
 static const unsigned button_class_id = 234245;
 
@@ -17,26 +18,21 @@ typedef struct _button {
 
     uint32_t last_press_time;
     uint32_t last_event_time;
-
-    struct _button *next;
 } button_t;
 
 
-button_t *buttons = NULL;
-
-
-static button_t *button_find_by_gpio(const uint8_t gpio_num) {
-    button_t *button = buttons;
-    while (button && button->gpio_num != gpio_num)
-        button = button->next;
-
-    return button;
+// Input task: calls back for an event queued by the interrupt, unless
+// the button was deleted meanwhile
+static void button_event_dispatch(uint8_t gpio_num, uint32_t event, uint32_t time) {
+    button_t *button = input_find(gpio_num);
+    if (button && button->class_id == button_class_id)
+        button->callback(gpio_num, event);
 }
 
-
 void button_intr_callback(uint8_t gpio) {
-    button_t *button = button_find_by_gpio(gpio);
-    if (!button)
+    // the registry is shared with the contact sensors
+    button_t *button = input_find(gpio);
+    if (!button || button->class_id != button_class_id)
         return;
 
     uint32_t now = xTaskGetTickCountFromISR();
@@ -45,25 +41,24 @@ void button_intr_callback(uint8_t gpio) {
         return;
     }
     button->last_event_time = now;
-    if (gpio_read(button->gpio_num) == button->pressed_value) {
+    if (input_read(button->gpio_num)) {
         // Record when the button is pressed down.
         button->last_press_time = now;
     } else {
         // The button is released. Handle the use cases.
         if ((now - button->last_press_time) * portTICK_PERIOD_MS > button->long_press_time) {
-            button->callback(button->gpio_num, button_event_long_press);
+            input_post(button_event_dispatch, button->gpio_num, button_event_long_press);
         } else {
-            button->callback(button->gpio_num, button_event_single_press);
+            input_post(button_event_dispatch, button->gpio_num, button_event_single_press);
         }
     }
 }
 
 int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_press_time, button_callback_fn callback) {
-    button_t *button = button_find_by_gpio(gpio_num);
-    if (button)
+    if (input_find(gpio_num) || input_queue_init())
         return -1;
 
-    button = malloc(sizeof(button_t));
+    button_t *button = malloc(sizeof(button_t));
     memset(button, 0, sizeof(*button));
     button->class_id = button_class_id;
     button->gpio_num = gpio_num;
@@ -78,10 +73,12 @@ int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_pres
     button->last_event_time = now;
     button->last_press_time = now;
 
-    button->next = buttons;
-    buttons = button;
+    if (input_register(gpio_num, button)) {
+        free(button);
+        return -1;
+    }
 
-    gpio_set_pullup(button->gpio_num, true, true);
+    input_configure(button->gpio_num, !pressed_value);
     gpio_set_interrupt(button->gpio_num, GPIO_INTTYPE_EDGE_ANY, button_intr_callback);
 
     return 0;
@@ -89,26 +86,12 @@ int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_pres
 
 
 void button_delete(const uint8_t gpio_num) {
-    if (!buttons)
+    button_t *button = input_find(gpio_num);
+    if (!button || button->class_id != button_class_id)
         return;
 
-    button_t *button = NULL;
-    if (buttons->gpio_num == gpio_num) {
-        button = buttons;
-        buttons = buttons->next;
-    } else {
-        button_t *b = buttons;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                button = b->next;
-                b->next = b->next->next;
-                break;
-            }
-        }
-    }
-
-    if (button) {
-        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
-    }
+    gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+    input_unregister(gpio_num);
+    free(button);
 }
 
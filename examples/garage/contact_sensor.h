@@ -1,12 +1,41 @@
 #pragma once
 
+#include <stdint.h>
+
+/*
+    Reed contacts bounce, and a slammed door rattles for much longer. Every
+    edge restarts a one-shot window of CONTACT_SENSOR_STABLE_MS (or
+    contact_sensor_set_stable_time()); when it expires without another
+    edge the level is settled, and the callback is called from the timer
+    task only if it differs from the last settled state. The other edges
+    of the window are counted as suppressed bounces.
+*/
+
+#define CONTACT_SENSOR_STABLE_MS 100
+
 typedef enum {
     CONTACT_CLOSED,
     CONTACT_OPEN
 } contact_sensor_state_t;
 
+typedef struct {
+    /* edges seen by the interrupt */
+    uint32_t edges;
+    /* settled state changes reported */
+    uint32_t changes;
+    /* edges that did not lead to a reported change */
+    uint32_t suppressed;
+} contact_sensor_stats_t;
+
 typedef void (*contact_sensor_callback_fn)(uint8_t gpio_num, contact_sensor_state_t event);
 
 int contact_sensor_create(uint8_t gpio_num, contact_sensor_callback_fn callback);
-void contact_sensor_destroy(uint8_t gpio_num);
+/* stops reporting at once; the descriptor and its timer are freed by the
+   timer task, needs INCLUDE_xTimerPendFunctionCall */
+void contact_sensor_delete(uint8_t gpio_num);
+/* the settled state while the contact bounces */
 contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num);
+/* stability window, at least one tick; also starts a window, which reports
+   a state changed without an edge (by input_config_set()); 0 on success */
+int contact_sensor_set_stable_time(uint8_t gpio_num, uint16_t stable_ms);
+int contact_sensor_get_stats(uint8_t gpio_num, contact_sensor_stats_t *stats);
@@ -0,0 +1,51 @@
+/*
+ * HomeKit Custom Characteristics
+ * 
+ * Copyright 2018 José A. Jiménez (@RavenSystem)
+ *  
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOMEKIT_CUSTOM_CHARACTERISTICS__
+#define __HOMEKIT_CUSTOM_CHARACTERISTICS__
+
+#define HOMEKIT_CUSTOM_UUID(value) (value "-03a1-4971-92bf-af2b7d833922")
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_GARAGEDOOR_SENSOR_CLOSE_NC HOMEKIT_CUSTOM_UUID("F0000111")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_GARAGEDOOR_SENSOR_CLOSE_NC(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_GARAGEDOOR_SENSOR_CLOSE_NC, \
+    .description = "Sensor Close NC", \
+    .format = homekit_format_bool, \
+    .permissions = homekit_permissions_paired_read \
+    | homekit_permissions_paired_write \
+    | homekit_permissions_notify, \
+    .value = HOMEKIT_BOOL_(_value), \
+    ##__VA_ARGS__
+
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_INCHING_TIME HOMEKIT_CUSTOM_UUID("F0000113")
+// 0.1 to 10s, the pulses relay_actor_pulse() accepts in whole 100ms steps
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_INCHING_TIME(_value, ...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_INCHING_TIME, \
+    .description = "Inching time", \
+    .format = homekit_format_float, \
+    .unit = homekit_unit_seconds, \
+    .permissions = homekit_permissions_paired_read \
+    | homekit_permissions_paired_write \
+    | homekit_permissions_notify, \
+    .min_value = (float[]) {0.1}, \
+    .max_value = (float[]) {10}, \
+    .min_step = (float[]) {0.1}, \
+    .value = HOMEKIT_FLOAT_(_value), \
+    ##__VA_ARGS__
+
+#endif
@@ -13,6 +13,9 @@
 #include <homekit/characteristics.h>
 #include "wifi.h"
 #include "contact_sensor.h"
+#include "input.h"
+#include "relay_actor.h"
+#include "custom_characteristics.h"
 
 // Possible values for characteristic CURRENT_DOOR_STATE:
 #define HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN 0
@@ -28,6 +31,11 @@
 
 #define OPEN_CLOSE_DURATION 22
 
+// Default relay pulse that toggles the door, see CUSTOM_INCHING_TIME
+#define INCHING_MS 400
+// Shortest pulse, the min_value of CUSTOM_INCHING_TIME
+#define INCHING_MIN_MS 100
+
 const char *state_description(uint8_t state) {
     const char* description = "unknown";
     switch (state) {
@@ -58,6 +66,10 @@ homekit_value_t gdo_target_state_get();
 void gdo_target_state_set(homekit_value_t new_value);
 homekit_value_t gdo_current_state_get();
 homekit_value_t gdo_obstruction_get();
+homekit_value_t inching_time_get();
+void inching_time_set(homekit_value_t new_value);
+homekit_value_t sensor_nc_get();
+void sensor_nc_set(homekit_value_t new_value);
 void identify(homekit_value_t _value);
 
 // Declare global variables:
@@ -90,6 +102,16 @@ homekit_accessory_t *accessories[] = {
                 .getter=gdo_obstruction_get,
                 .setter=NULL
             ),
+            HOMEKIT_CHARACTERISTIC(
+                CUSTOM_INCHING_TIME, INCHING_MS / 1000.0,
+                .getter=inching_time_get,
+                .setter=inching_time_set
+            ),
+            HOMEKIT_CHARACTERISTIC(
+                CUSTOM_GARAGEDOOR_SENSOR_CLOSE_NC, false,
+                .getter=sensor_nc_get,
+                .setter=sensor_nc_set
+            ),
             NULL
         }),
         NULL
@@ -98,36 +120,42 @@ homekit_accessory_t *accessories[] = {
 };
 
 bool relay_on = false;
+uint32_t inching_ms = INCHING_MS;
 uint8_t current_door_state = HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_UNKNOWN;
 ETSTimer update_timer; // used for delayed updating from contact sensor
 
 
 
 void relay_write(bool on) {
-    gpio_write(RELAY_PIN, on ? 0 : 1);
+    relay_actor_write(on);
 }
 
 void relay_init() {
-    gpio_enable(RELAY_PIN, GPIO_OUTPUT);
+    // the relay input is active low
+    if (relay_actor_init(RELAY_PIN, true)) {
+        printf("Failed to initialize relay\n");
+    }
     relay_write(relay_on);
 }
 
 void identify_task(void *_args) {
     // 1. move the door, 2. stop it, 3. move it back:
     for (int i=0; i<3; i++) {
-            relay_write(true);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            relay_write(false);
-            vTaskDelay(3500 / portTICK_PERIOD_MS);
+            relay_actor_pulse(500);
+            vTaskDelay(4000 / portTICK_PERIOD_MS);
     }
 
-    relay_write(false);
-
     vTaskDelete(NULL);
 }
 
 void identify(homekit_value_t _value) {
+    input_queue_stats_t queue_stats;
+
     printf("GDO identify\n");
+    // the button events pass the input queue, see button_sensor.c
+    input_get_queue_stats(&queue_stats);
+    printf("Input queue: %u events posted, %u dropped, %u waiting (%u at most)\n",
+        queue_stats.posted, queue_stats.overflows, queue_stats.depth, queue_stats.max_depth);
     xTaskCreate(identify_task, "GDO identify", 128, NULL, 2, NULL);
 }
 
@@ -149,6 +177,51 @@ homekit_value_t gdo_obstruction_get() {
     return HOMEKIT_BOOL(false);
 }
 
+homekit_value_t inching_time_get() {
+    return HOMEKIT_FLOAT(inching_ms / 1000.0f);
+}
+
+void inching_time_set(homekit_value_t new_value) {
+    if (new_value.format != homekit_format_float) {
+        printf("Invalid value format: %d\n", new_value.format);
+        return;
+    }
+    if (new_value.float_value < 0 || new_value.float_value * 1000 + 0.5f < INCHING_MIN_MS
+            || new_value.float_value * 1000 + 0.5f > RELAY_ACTOR_MAX_MS + 0.5f) {
+        printf("Invalid inching time: %d ms\n", (int)(new_value.float_value * 1000));
+        return;
+    }
+
+    // rounded, so 0.1 and 10 s are not lost to float error
+    inching_ms = new_value.float_value * 1000 + 0.5f;
+    printf("Inching time set to %u ms\n", inching_ms);
+}
+
+homekit_value_t sensor_nc_get() {
+    bool inverted, pullup;
+
+    input_config_get(REED_PIN, &inverted, &pullup);
+    return HOMEKIT_BOOL(inverted);
+}
+
+// Normally closed reed contact: inverts the sensor input, saved in flash
+void sensor_nc_set(homekit_value_t new_value) {
+    bool inverted, pullup;
+
+    if (new_value.format != homekit_format_bool) {
+        printf("Invalid value format: %d\n", new_value.format);
+        return;
+    }
+    input_config_get(REED_PIN, &inverted, &pullup);
+    if (input_config_set(REED_PIN, new_value.bool_value, pullup)) {
+        printf("Failed to save sensor configuration\n");
+        return;
+    }
+    printf("Sensor contact set to normally %s\n", new_value.bool_value ? "closed" : "open");
+    // no edge tells the sensor about it, a new window reports the inverted state
+    contact_sensor_set_stable_time(REED_PIN, REED_STABLE_MS);
+}
+
 void gdo_current_state_notify_homekit() {
 
     homekit_value_t new_value = HOMEKIT_UINT8(current_door_state);
@@ -227,12 +300,16 @@ homekit_value_t gdo_target_state_get() {
 }
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the timer task once the contact settled in a new state, to notify the client of the change.
  **/
 void contact_sensor_state_changed(uint8_t gpio, contact_sensor_state_t state) {
 
     printf("contact sensor state '%s'.\n", state == CONTACT_OPEN ? "open" : "closed");
 
+    contact_sensor_stats_t stats;
+    contact_sensor_get_stats(gpio, &stats);
+    printf("Contact sensor: %u edges, %u changes, %u bounces suppressed\n", stats.edges, stats.changes, stats.suppressed);
+
     if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING ||
         current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
 	// Ignore the event - the state will be updated after the time expired!
@@ -261,13 +338,12 @@ void gdo_target_state_set(homekit_value_t new_value) {
         return;
     }
 
-    // Toggle the garage door by toggling the relay connected to the GPIO (on - off):
-    // Turn ON GPIO:
-    relay_write(true);
-    // Wait for some time:
-    vTaskDelay(400 / portTICK_PERIOD_MS);
-    // Turn OFF GPIO:
-    relay_write(false);
+    // Toggle the garage door by pulsing the relay connected to the GPIO,
+    // the hardware timer turns it off again after inching_ms:
+    if (relay_actor_pulse(inching_ms)) {
+        printf("gdo_target_state_set() ignored: relay pulse still running.\n");
+        return;
+    }
     if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED) {
         current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING);
     } else {
@@ -304,7 +380,8 @@ void user_init(void) {
 
 
     printf("Using Sensor at GPIO%d.\n", REED_PIN);
-    if (contact_sensor_create(REED_PIN, contact_sensor_state_changed)) {
+    if (contact_sensor_create(REED_PIN, contact_sensor_state_changed) ||
+        contact_sensor_set_stable_time(REED_PIN, REED_STABLE_MS)) {
         printf("Failed to initialize door\n");
     }
 
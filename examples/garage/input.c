@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <esp8266.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <sysparam.h>
+
+#include "input.h"
+
+#define INPUT_TASK_STACK 512
+#define INPUT_TASK_PRIORITY 2
+
+void *input_registry[INPUT_GPIO_COUNT];
+
+volatile uint32_t input_xor;
+
+/* sysparam keys of the configuration masks, bit n for GPIOn */
+#define INPUT_KEY_INVERTED "input.inverted"
+#define INPUT_KEY_NO_PULLUP "input.no_pullup"
+
+/* configuration, loaded from flash on first use */
+static uint32_t config_inverted;
+static uint32_t config_no_pullup;
+static bool config_loaded;
+/* the drivers' own polarity, from input_configure() */
+static uint32_t active_low;
+
+static QueueHandle_t input_queue;
+static input_queue_stats_t stats;
+
+int input_register(uint8_t gpio_num, void *input) {
+    if ((gpio_num >= INPUT_GPIO_COUNT) || !input || input_registry[gpio_num])
+        return -1;
+
+    input_registry[gpio_num] = input;
+    return 0;
+}
+
+void input_unregister(uint8_t gpio_num) {
+    if (gpio_num < INPUT_GPIO_COUNT)
+        input_registry[gpio_num] = NULL;
+}
+
+static void input_config_load(void) {
+    int32_t value;
+
+    if (config_loaded)
+        return;
+    if (sysparam_get_int32(INPUT_KEY_INVERTED, &value) == SYSPARAM_OK)
+        config_inverted = value;
+    if (sysparam_get_int32(INPUT_KEY_NO_PULLUP, &value) == SYSPARAM_OK)
+        config_no_pullup = value;
+    config_loaded = true;
+}
+
+/* pull-up and input_xor bit of gpio_num from the configuration */
+static void input_config_apply(uint8_t gpio_num) {
+    uint32_t bit = 1U << gpio_num;
+
+    gpio_set_pullup(gpio_num, !(config_no_pullup & bit), true);
+    taskENTER_CRITICAL();
+    input_xor = (input_xor & ~bit) | ((active_low ^ config_inverted) & bit);
+    taskEXIT_CRITICAL();
+}
+
+void input_configure(uint8_t gpio_num, bool low) {
+    if (gpio_num >= INPUT_GPIO_COUNT)
+        return;
+
+    input_config_load();
+    if (low)
+        active_low |= 1U << gpio_num;
+    else
+        active_low &= ~(1U << gpio_num);
+    input_config_apply(gpio_num);
+}
+
+int input_config_set(uint8_t gpio_num, bool inverted, bool pullup) {
+    uint32_t bit = 1U << gpio_num;
+    uint32_t new_inverted, new_no_pullup;
+    int result = 0;
+
+    if (gpio_num >= INPUT_GPIO_COUNT)
+        return -1;
+
+    input_config_load();
+    new_inverted = inverted ? (config_inverted | bit) : (config_inverted & ~bit);
+    new_no_pullup = pullup ? (config_no_pullup & ~bit) : (config_no_pullup | bit);
+    if ((new_inverted != config_inverted) &&
+        (sysparam_set_int32(INPUT_KEY_INVERTED, new_inverted) != SYSPARAM_OK))
+        return -1;
+    if ((new_no_pullup != config_no_pullup) &&
+        (sysparam_set_int32(INPUT_KEY_NO_PULLUP, new_no_pullup) != SYSPARAM_OK)) {
+        /* undo the saved inversion; should that fail too, flash keeps it,
+           so it is applied with the old pull-up for flash, RAM and the
+           input to agree */
+        if ((new_inverted == config_inverted) ||
+            (sysparam_set_int32(INPUT_KEY_INVERTED, config_inverted) == SYSPARAM_OK))
+            return -1;
+        new_no_pullup = config_no_pullup;
+        result = -1;
+    }
+    config_inverted = new_inverted;
+    config_no_pullup = new_no_pullup;
+
+    if (input_registry[gpio_num])
+        input_config_apply(gpio_num);
+    return result;
+}
+
+void input_config_get(uint8_t gpio_num, bool *inverted, bool *pullup) {
+    uint32_t bit = (gpio_num < INPUT_GPIO_COUNT) ? 1U << gpio_num : 0;
+
+    input_config_load();
+    *inverted = config_inverted & bit;
+    *pullup = !(config_no_pullup & bit);
+}
+
+static void input_task(void *_args) {
+    input_event_t event;
+    uint32_t reported = 0;
+
+    for (;;) {
+        if (xQueueReceive(input_queue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        if (stats.overflows != reported) {
+            reported = stats.overflows;
+            printf("input: %u events dropped on a full queue\n", reported);
+        }
+        event.handler(event.gpio_num, event.value, event.time);
+    }
+}
+
+int input_queue_init(void) {
+    if (input_queue)
+        return 0;
+
+    input_queue = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(input_event_t));
+    if (!input_queue)
+        return -1;
+
+    if (xTaskCreate(input_task, "Input", INPUT_TASK_STACK, NULL, INPUT_TASK_PRIORITY, NULL) != pdPASS) {
+        vQueueDelete(input_queue);
+        input_queue = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int input_post(input_event_fn handler, uint8_t gpio_num, uint32_t value) {
+    BaseType_t woken = pdFALSE;
+    input_event_t event = {
+        .handler = handler,
+        .time = xTaskGetTickCountFromISR(),
+        .value = value,
+        .gpio_num = gpio_num,
+    };
+    uint32_t depth;
+
+    if (!input_queue || (xQueueSendToBackFromISR(input_queue, &event, &woken) != pdTRUE)) {
+        stats.overflows++;
+        return -1;
+    }
+    stats.posted++;
+
+    depth = uxQueueMessagesWaitingFromISR(input_queue);
+    if (depth > stats.max_depth)
+        stats.max_depth = depth;
+
+    portYIELD_FROM_ISR(woken);
+    return 0;
+}
+
+void input_get_queue_stats(input_queue_stats_t *stats_out) {
+    *stats_out = stats;
+    stats_out->depth = input_queue ? uxQueueMessagesWaiting(input_queue) : 0;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp/gpio.h>
+
+/*
+    GPIO-indexed registry of input descriptors (buttons, contact sensors).
+
+    GPIO interrupt handlers only get the pin number; they look up the
+    descriptor that owns it with one array index instead of walking a list.
+    The table is static, one slot per GPIO0..16, and shared by all input
+    drivers of the program, so each pin can be claimed only once.
+*/
+
+#define INPUT_GPIO_COUNT 17
+
+extern void *input_registry[INPUT_GPIO_COUNT];
+
+/**
+    Claims a GPIO pin for an input descriptor.
+
+    @param gpio_num GPIO0..16
+    @param input The driver's descriptor, returned by input_find()
+    @return 0, or -1 if gpio_num is invalid or already claimed
+*/
+int input_register(uint8_t gpio_num, void *input);
+
+/**
+    Releases a GPIO pin; disable its interrupt first.
+*/
+void input_unregister(uint8_t gpio_num);
+
+/**
+    Constant time, safe to call from an interrupt.
+
+    @return The descriptor registered for gpio_num, or NULL
+*/
+static inline void *input_find(uint8_t gpio_num) {
+    return (gpio_num < INPUT_GPIO_COUNT) ? input_registry[gpio_num] : NULL;
+}
+
+/*
+    Deferred input events.
+
+    Interrupt handlers post an event instead of calling back into the
+    application; one input task drains the queue in order and calls the
+    event's handler, where printf() and HomeKit notifications are safe.
+    Posting copies one small struct into a FreeRTOS queue, constant time.
+    When the queue is full the event is dropped and counted.
+*/
+
+#define INPUT_QUEUE_LENGTH 16
+
+/* called from the input task */
+typedef void (*input_event_fn)(uint8_t gpio_num, uint32_t value, uint32_t time);
+
+typedef struct {
+    input_event_fn handler;
+    /* tick count when the interrupt saw the input */
+    uint32_t time;
+    uint32_t value;
+    uint8_t gpio_num;
+} input_event_t;
+
+typedef struct {
+    uint32_t posted;
+    /* events dropped on a full queue */
+    uint32_t overflows;
+    /* events waiting now, and the most ever waiting */
+    uint32_t depth;
+    uint32_t max_depth;
+} input_queue_stats_t;
+
+/**
+    Creates the queue and the input task, once; call from a task before
+    the first input_post().
+
+    @return 0, or -1 if they could not be created
+*/
+int input_queue_init(void);
+
+/**
+    Queues handler(gpio_num, value, time) for the input task; to be called
+    from an interrupt.
+
+    @return 0, or -1 if the queue is full or not created
+*/
+int input_post(input_event_fn handler, uint8_t gpio_num, uint32_t value);
+
+/**
+    @param stats Receives the queue counters
+*/
+void input_get_queue_stats(input_queue_stats_t *stats);
+
+/*
+    Runtime input configuration.
+
+    Whether an input is inverted (a reversed switch, a normally closed
+    contact) and whether its internal pull-up is on is kept per GPIO as
+    two bit masks in flash (sysparam), so one firmware fits every wiring.
+    input_configure() folds the inversion and the driver's own active
+    level into input_xor, which drivers apply with a single XOR to the raw
+    input read; nothing is added per sample.
+
+    A change takes effect at the next sample or edge of the input; users
+    of edge-triggered inputs re-read their state after input_config_set().
+*/
+
+/* bit n: GPIOn reads inverted, the driver's level and the configuration combined */
+extern volatile uint32_t input_xor;
+
+/**
+    Applies the configuration to a registered input, its pull-up and its
+    bit in input_xor; drivers call it from their create function.
+
+    @param active_low The driver's own polarity, such as !pressed_value
+*/
+void input_configure(uint8_t gpio_num, bool active_low);
+
+/**
+    Changes the configuration of gpio_num, saves it to flash and applies
+    it to the input registered on it, if any; call from a task.
+
+    @return 0, or -1 if gpio_num is invalid or the flash write failed;
+    the configuration is then unchanged, or holds just what could not be
+    undone in flash, applied to the input as well
+*/
+int input_config_set(uint8_t gpio_num, bool inverted, bool pullup);
+
+/**
+    @param inverted, pullup Receive the configuration of gpio_num
+*/
+void input_config_get(uint8_t gpio_num, bool *inverted, bool *pullup);
+
+/**
+    @return The level of gpio_num after input_xor, 1 for an active input
+    of an active-high driver
+*/
+static inline bool input_read(uint8_t gpio_num) {
+    return gpio_read(gpio_num) ^ ((input_xor >> gpio_num) & 1);
+}
@@ -7,3 +7,118 @@
 //
 
 #include "relay_actor.h"
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <xtensa/hal.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+// FRC1 at 80MHz / 256: 312.5 ticks per ms, 26.8s range
+#define RELAY_ACTOR_DIV TIMER_CLKDIV_256
+#define RELAY_ACTOR_COUNTS(ms) ((ms) * 625 / 2)
+
+static uint8_t relay_gpio;
+static bool relay_active_low;
+static volatile bool busy;
+
+// pulse edges, written by relay_actor_pulse() and the interrupt
+static uint32_t start_ccount;
+static volatile uint32_t end_ccount;
+static uint32_t requested_ms;
+
+static TaskHandle_t log_task_handle;
+static relay_actor_stats_t stats;
+
+static void relay_actor_log_task(void *_args) {
+    uint32_t cycles_per_us = sdk_system_get_cpu_freq();
+    uint32_t actual_us, error_us;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        actual_us = (end_ccount - start_ccount) / cycles_per_us;
+        error_us = actual_us > requested_ms * 1000 ?
+            actual_us - requested_ms * 1000 : requested_ms * 1000 - actual_us;
+
+        stats.pulses++;
+        stats.requested_ms = requested_ms;
+        stats.actual_us = actual_us;
+        if (error_us > stats.worst_error_us)
+            stats.worst_error_us = error_us;
+
+        printf("Inching pulse: requested %u ms, actual %u.%03u ms\n",
+            requested_ms, actual_us / 1000, actual_us % 1000);
+    }
+}
+
+static IRAM void relay_actor_timer_handler(void *arg) {
+    BaseType_t woken = pdFALSE;
+
+    gpio_write(relay_gpio, relay_active_low);
+    end_ccount = xthal_get_ccount();
+    timer_set_run(FRC1, false);
+    busy = false;
+
+    vTaskNotifyGiveFromISR(log_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+int relay_actor_init(uint8_t gpio_num, bool active_low) {
+    relay_gpio = gpio_num;
+    relay_active_low = active_low;
+    busy = false;
+
+    gpio_enable(relay_gpio, GPIO_OUTPUT);
+    gpio_write(relay_gpio, relay_active_low);
+
+    if (xTaskCreate(relay_actor_log_task, "Inching log", 256, NULL, 2, &log_task_handle) != pdPASS)
+        return -1;
+
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+    _xt_isr_attach(INUM_TIMER_FRC1, relay_actor_timer_handler, NULL);
+    timer_set_divider(FRC1, RELAY_ACTOR_DIV);
+    timer_set_reload(FRC1, false);
+    timer_set_interrupts(FRC1, true);
+
+    return 0;
+}
+
+void relay_actor_write(bool on) {
+    taskENTER_CRITICAL();
+    timer_set_run(FRC1, false);
+    busy = false;
+    gpio_write(relay_gpio, on != relay_active_low);
+    taskEXIT_CRITICAL();
+}
+
+int relay_actor_pulse(uint32_t ms) {
+    if (!ms || ms > RELAY_ACTOR_MAX_MS)
+        return -1;
+
+    // busy checked and set with the relay on and timer start, so two
+    // callers cannot both start a pulse
+    taskENTER_CRITICAL();
+    if (busy) {
+        taskEXIT_CRITICAL();
+        return -1;
+    }
+    busy = true;
+    requested_ms = ms;
+    gpio_write(relay_gpio, !relay_active_low);
+    start_ccount = xthal_get_ccount();
+    timer_set_load(FRC1, RELAY_ACTOR_COUNTS(ms));
+    timer_set_run(FRC1, true);
+    taskEXIT_CRITICAL();
+
+    return 0;
+}
+
+bool relay_actor_busy(void) {
+    return busy;
+}
+
+void relay_actor_get_stats(relay_actor_stats_t *stats_out) {
+    *stats_out = stats;
+}
@@ -10,5 +10,41 @@
 #define relay_actor_h
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Inching: momentary relay pulses timed by the FRC1 hardware timer instead
+ * of vTaskDelay(), so their width does not depend on the tick rate or on
+ * what else is running. The relay is switched on from the calling task and
+ * off from the timer interrupt; a logging task prints the requested and
+ * the measured width of every pulse.
+ */
+
+// Longest pulse, the max_value of CUSTOM_INCHING_TIME
+#define RELAY_ACTOR_MAX_MS 10000
+
+typedef struct {
+    uint32_t pulses;
+    // last pulse
+    uint32_t requested_ms;
+    uint32_t actual_us;
+    // largest |actual - requested| so far
+    uint32_t worst_error_us;
+} relay_actor_stats_t;
+
+// Sets up the relay output (off) and the FRC1 timer; call once
+int relay_actor_init(uint8_t gpio_num, bool active_low);
+
+// Steady on/off, cancels a running pulse
+void relay_actor_write(bool on);
+
+// Switches the relay on for ms milliseconds; returns -1 if a pulse is
+// still running or ms is out of range
+int relay_actor_pulse(uint32_t ms);
+
+bool relay_actor_busy(void);
+
+void relay_actor_get_stats(relay_actor_stats_t *stats);
 
 #endif /* relay_actor_h */
@@ -0,0 +1,164 @@
+/*
+ * Runs ../dimmer/button.c on the virtual hardware of sim.c with 1, 4 and
+ * 16 active-low buttons (or the counts given as arguments) and reports
+ * how often the sampling timers ran and the host time spent in them.
+ *
+ * Each button is pressed every 2s, bouncing on both edges, staggered by
+ * 37ms per button; every tenth press is held for 1.5s. The press and
+ * release callbacks are checked against the generated presses.
+ *
+ * Built twice by the Makefile: button_bench with the scanner
+ * (BUTTON_SCANNER=1) and button_bench_timers with a timer per button.
+ * The exit status is the number of runs with missing or extra events.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <FreeRTOS.h>
+#include "sim.h"
+#include "button.h"
+
+#define BENCH_SECONDS       600
+#define PRESS_PERIOD_MS     2000
+#define STAGGER_MS          37
+#define SHORT_MS            150
+#define LONG_MS             1500
+#define LONG_EVERY          10
+
+typedef struct {
+    uint64_t time;
+    uint8_t gpio_num;
+    bool level;
+} bench_edge_t;
+
+static bench_edge_t *edges;
+static uint32_t edge_count, edge_size;
+
+static uint32_t releases, holds, bad_periods;
+
+static void edge_add(uint64_t time, uint8_t gpio_num, bool level)
+{
+    if (edge_count == edge_size) {
+        edge_size = edge_size ? 2 * edge_size : 4096;
+        edges = realloc(edges, edge_size * sizeof(*edges));
+    }
+    edges[edge_count].time = time;
+    edges[edge_count].gpio_num = gpio_num;
+    edges[edge_count].level = level;
+    edge_count++;
+}
+
+/* settles on level after 1.2ms of contact bounce */
+static void bounce_add(uint64_t time, uint8_t gpio_num, bool level)
+{
+    edge_add(time, gpio_num, level);
+    edge_add(time + SIM_US(300), gpio_num, !level);
+    edge_add(time + SIM_US(700), gpio_num, level);
+    edge_add(time + SIM_US(900), gpio_num, !level);
+    edge_add(time + SIM_US(1200), gpio_num, level);
+}
+
+static int edge_compare(const void *a, const void *b)
+{
+    const bench_edge_t *x = a, *y = b;
+
+    return x->time < y->time ? -1 : x->time > y->time;
+}
+
+static bool near(uint32_t period, uint32_t ms)
+{
+    return period + 20 >= ms && period <= ms + 20;
+}
+
+static void button_callback(uint8_t gpio_num, bool pressed, uint32_t period)
+{
+    if (pressed) {
+        holds++;
+        return;
+    }
+    releases++;
+    /* the debounced press lasts as long as the contact, to a sample */
+    if (!near(period, SHORT_MS) && !near(period, LONG_MS))
+        bad_periods++;
+}
+
+static int bench(FILE *out, int buttons)
+{
+    uint32_t presses = 0, longs = 0, ticks, i;
+    uint64_t t;
+    int gpio;
+
+    sim_reset();
+    edge_count = releases = holds = bad_periods = 0;
+
+    for (gpio = 0; gpio < buttons; gpio++) {
+        /* pulled up, pressed at low level */
+        sim_gpio_input(gpio, true);
+        if (button_create(gpio, false, button_callback)) {
+            fprintf(out, "button_create(%d) failed\n", gpio);
+            return 1;
+        }
+        for (t = SIM_MS(100 + gpio * STAGGER_MS), i = 0;
+                t + SIM_MS(PRESS_PERIOD_MS) < SIM_MS(BENCH_SECONDS * 1000ULL);
+                t += SIM_MS(PRESS_PERIOD_MS), i++) {
+            uint32_t hold = (i % LONG_EVERY) == LONG_EVERY - 1 ? LONG_MS : SHORT_MS;
+
+            bounce_add(t, gpio, false);
+            bounce_add(t + SIM_MS(hold), gpio, true);
+            presses++;
+            longs += hold == LONG_MS;
+        }
+    }
+    qsort(edges, edge_count, sizeof(*edges), edge_compare);
+
+    for (i = 0; i < edge_count; i++) {
+        sim_run_until(edges[i].time);
+        sim_gpio_input(edges[i].gpio_num, edges[i].level);
+    }
+    sim_run_until(SIM_MS(BENCH_SECONDS * 1000ULL));
+
+    for (gpio = 0; gpio < buttons; gpio++)
+        button_delete(gpio);
+
+    ticks = BENCH_SECONDS * 1000 / portTICK_PERIOD_MS;
+    fprintf(out, "%2d buttons: %5u/%u releases, %u/%u holds, %6u timer calls"
+            " (%.2f per tick), %5.0f ns per call, %6.0f ns per second\n",
+            buttons, releases, presses, holds, longs, sim_timer_calls,
+            (double)sim_timer_calls / ticks,
+            sim_timer_calls ? (double)sim_timer_ns / sim_timer_calls : 0.0,
+            (double)sim_timer_ns / BENCH_SECONDS);
+
+    if (releases != presses || holds != longs || bad_periods) {
+        fprintf(out, "  FAIL: %u presses with a wrong length\n", bad_periods);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int counts[] = { 1, 4, 16 };
+    FILE *out;
+    int failed = 0, i;
+
+    /* button.c reports every press on stdout */
+    fflush(stdout);
+    out = fdopen(dup(1), "w");
+    if (!out || !freopen("/dev/null", "w", stdout))
+        return 1;
+
+    fprintf(out, "%s, %d simulated seconds\n", BUTTON_SCANNER
+            ? "one scanner timer for all buttons" : "one timer per button",
+            BENCH_SECONDS);
+    if (argc > 1) {
+        for (i = 1; i < argc; i++)
+            failed += bench(out, atoi(argv[i]));
+    } else {
+        for (i = 0; i < 3; i++)
+            failed += bench(out, counts[i]);
+    }
+    fclose(out);
+    return failed;
+}
@@ -0,0 +1,134 @@
+/*
+ * Runs the reed contact debouncing of ../door-sensor/contact_sensor.c on
+ * the virtual hardware of sim.c, for scripted door movements on GPIO4.
+ * The contact starts closed (low).
+ *
+ * Script commands, one per line ('#' starts a comment):
+ *   window <ms>                  stability window, contact_sensor_set_stable_time()
+ *   delete | create              contact_sensor_delete(), contact_sensor_create()
+ *   open <ms> | close <ms>       move the contact and keep it there
+ *   trace <ms>...                toggle the contact at each entry and keep
+ *                                it for the given time, like a rattle
+ *   expect <state>...            the reported changes since the last
+ *                                expect: open, closed, or none
+ *   expect stats <edges> <changes> <suppressed>
+ *                                contact_sensor_get_stats() counters
+ *
+ * The exit status is the number of failed expectations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "contact_sensor.h"
+
+#define REED_GPIO 4
+
+static char reported[1024];
+static bool level;
+
+static void contact_changed(uint8_t gpio_num, contact_sensor_state_t state)
+{
+    const char *name = state == CONTACT_OPEN ? "open" : "closed";
+
+    printf("%8.1f ms: %s\n", (double)sim_now / SIM_MS(1), name);
+    snprintf(reported + strlen(reported), sizeof(reported) - strlen(reported),
+            "%s%s", reported[0] ? " " : "", name);
+}
+
+static void contact(bool open, double ms)
+{
+    level = open;
+    sim_gpio_input(REED_GPIO, level);
+    sim_run_until(sim_now + SIM_US(ms * 1000));
+}
+
+int main(int argc, char **argv)
+{
+    FILE *script = stdin;
+    char line[512], cmd[32], want[512], *p, *tok;
+    double a;
+    unsigned edges, changes, suppressed;
+    int failed = 0, lineno = 0, offset;
+    contact_sensor_stats_t stats;
+    clock_t started = clock();
+
+    if (argc > 1 && !(script = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    sim_reset();
+    sim_gpio_input(REED_GPIO, level);
+    if (contact_sensor_create(REED_GPIO, contact_changed)) {
+        printf("contact_sensor_create() failed\n");
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), script)) {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        lineno++;
+        if (sscanf(line, "%31s", cmd) != 1)
+            continue;
+
+        if (!strcmp(cmd, "window")) {
+            sscanf(line, "%*s %lf", &a);
+            if (contact_sensor_set_stable_time(REED_GPIO, a)) {
+                printf("line %d: window not set\n", lineno);
+                failed++;
+            }
+        } else if (!strcmp(cmd, "delete")) {
+            contact_sensor_delete(REED_GPIO);
+        } else if (!strcmp(cmd, "create")) {
+            if (contact_sensor_create(REED_GPIO, contact_changed)) {
+                printf("line %d: contact_sensor_create() failed\n", lineno);
+                failed++;
+            }
+        } else if (!strcmp(cmd, "open") || !strcmp(cmd, "close")) {
+            sscanf(line, "%*s %lf", &a);
+            contact(!strcmp(cmd, "open"), a);
+        } else if (!strcmp(cmd, "trace")) {
+            p = line + strlen("trace");
+            while (sscanf(p, "%lf%n", &a, &offset) == 1) {
+                contact(!level, a);
+                p += offset;
+            }
+        } else if (!strcmp(cmd, "expect")) {
+            if (sscanf(line, "%*s stats %u %u %u", &edges, &changes, &suppressed) == 3) {
+                contact_sensor_get_stats(REED_GPIO, &stats);
+                printf("  %u edges, %u changes, %u suppressed\n",
+                        stats.edges, stats.changes, stats.suppressed);
+                if (stats.edges != edges || stats.changes != changes
+                        || stats.suppressed != suppressed) {
+                    printf("  FAIL: expected %u edges, %u changes, %u suppressed\n",
+                            edges, changes, suppressed);
+                    failed++;
+                }
+                continue;
+            }
+            want[0] = 0;
+            for (tok = strtok(line + strlen("expect"), " \t\r\n"); tok;
+                    tok = strtok(NULL, " \t\r\n"))
+                snprintf(want + strlen(want), sizeof(want) - strlen(want),
+                        "%s%s", want[0] ? " " : "", tok);
+            if (strcmp(reported[0] ? reported : "none", want)) {
+                printf("  FAIL: got '%s', expected '%s'\n",
+                        reported[0] ? reported : "none", want);
+                failed++;
+            }
+            reported[0] = 0;
+        } else {
+            printf("line %d: unknown command %s\n", lineno, cmd);
+            failed++;
+        }
+    }
+
+    printf("simulated %.1f ms in %.1f ms, %d failed\n",
+            (double)sim_now / SIM_MS(1),
+            1000.0 * (clock() - started) / CLOCKS_PER_SEC, failed);
+    return failed;
+}
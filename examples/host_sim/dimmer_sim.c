@@ -0,0 +1,562 @@
+/*
+ * Runs the ../dimmer zero-cross tracker, brightness curves and triac
+ * scheduler on the virtual hardware of sim.c, fed by a synthetic mains
+ * zero-cross detector, and measures the firing angle and delivered power
+ * of every half-cycle.
+ *
+ * Script commands, one per line ('#' starts a comment):
+ *   mains <hz> [<drift hz/s>]       mains frequency, drifting linearly;
+ *                                   0 for no crossings at all
+ *   jitter <us>                     crossings move by up to +-us
+ *   bounce <edges> <us>             extra detector edges after each crossing
+ *   detector <pulse us> [<lag us>]  detector pulse width and delay
+ *   glitch <us>                     one spurious detector pulse, us after
+ *                                   the next real crossing
+ *   latency <us> [<jitter us>]      interrupt entry latency
+ *   curve phase|power|perceptual    dimmer_curve_init()
+ *   channel <gpio>                  triac_channel_create()
+ *   fade <ms>                       triac_set_fade()
+ *   lag <us>                        triac_set_lag()
+ *   set <channel> <0..100>          triac_channel_set()
+ *   relay <gpio> <close us> <open us>
+ *                                   relay_create(), with the real delays
+ *   sense <0|1>                     report contact changes to relay_sensed()
+ *   switch <0|1>                    relay_set()
+ *   trace <file>                    write every measured half-cycle as CSV
+ *   run <ms>                        advance time, report zero-cross and
+ *                                   firing statistics
+ *   sweep <channel> <from> <to> <step> <ms>
+ *                                   one report line per brightness
+ *   expect hz <hz>                  checks on the last run
+ *   expect locked <0|1>
+ *   expect missed <max>             real crossings not accepted, or extra
+ *   expect late <max us>            worst timer event lateness so far
+ *   expect angle <channel> <deg> <tol deg>
+ *   expect jitter <channel> <max deg>
+ *   expect power <channel> <%> <tol %>
+ *   expect overlaps <channel> <max> gate still high at a crossing
+ *   expect contact <max us>         relay contacts to the nearest crossing
+ *   expect switches <n>             relay contact changes in the last run
+ *   expect immediate <n>            relay switches not timed by a crossing,
+ *                                   since the start
+ *   expect close <us> <tol us>      learned delays
+ *   expect open <us> <tol us>
+ *
+ * Angles are measured from the real (not detected) zero-crossing, so
+ * detector lag, jitter and interrupt latency all show up in them.
+ * The exit status is the number of failed expectations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <esp8266.h>
+#include <xtensa/hal.h>
+
+#include "sim.h"
+#include "zerocross.h"
+#include "curve.h"
+#include "triac.h"
+#include "relay.h"
+
+#define ZEROCROSS_GPIO 3
+/* the scheduler needs a few crossings to lock and settle */
+#define SETTLE_HALF_CYCLES 3
+
+static struct {
+    double hz;
+    double drift;
+    double jitter_us;
+    uint32_t bounce_edges;
+    double bounce_us;
+    double pulse_us;
+    double lag_us;
+    /* spurious pulse after the next crossing, 0 for none */
+    double glitch_us;
+    /* time of the next real crossing, ticks */
+    double next;
+} mains = { 50, 0, 0, 0, 0, 500, 0, 0, 0 };
+
+/* detector edges of the current crossing, in time order */
+static struct {
+    uint64_t time;
+    bool level;
+} edges[2 * 64 + 2];
+static uint32_t edge_count, edge_next;
+
+/* real crossings since the start of the current run */
+static uint64_t *crossings;
+static uint32_t crossing_count, crossing_size;
+
+static uint8_t channel_gpio[TRIAC_MAX_CHANNELS];
+static uint8_t channel_brightness[TRIAC_MAX_CHANNELS];
+static int channel_count;
+
+typedef struct {
+    uint32_t half_cycles;
+    uint32_t fired;
+    uint32_t overlaps;
+    double angle;           /* mean firing angle, degrees */
+    double jitter;          /* its standard deviation */
+    double power;           /* mean delivered power, 0..1 */
+} firing_t;
+
+static struct {
+    zerocross_stats_t zc;
+    uint32_t crossings;
+    firing_t channels[TRIAC_MAX_CHANNELS];
+} last;
+
+/* relay under test: its coil output and real mechanical delays */
+static struct {
+    int index;
+    uint8_t gpio;
+    double delay_us[2];
+    bool sense;
+    bool coil;
+    bool contact_pending;
+    uint64_t contact;
+    /* the last two real crossings generated, the next is mains.next */
+    double crossing[2];
+    /* contact changes during the last run */
+    uint32_t switches;
+    double error_us;
+    double error_max_us;
+} relay = { -1 };
+
+static FILE *trace;
+
+/* same as zerocross_intr_callback() in ../dimmer/main.c */
+static void zerocross_intr(uint8_t gpio)
+{
+    uint32_t now = xthal_get_ccount();
+
+    if (!zerocross_tracker_edge(now))
+        return;
+    relay_zerocross(now, zerocross_half_period_us());
+    triac_zerocross(zerocross_half_period_us());
+}
+
+static double uniform(double range)
+{
+    return range * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+static void edge_add(double time, bool level)
+{
+    edges[edge_count].time = time < sim_now ? sim_now : (uint64_t)time;
+    edges[edge_count].level = level;
+    edge_count++;
+}
+
+/* Detector output for the next real crossing: a pulse starting lag_us
+ * after it, with bounce_edges short dropouts spread over bounce_us */
+static void mains_crossing(void)
+{
+    /* SIM_US() is unsigned, lag and jitter may be negative */
+    double start = mains.next + (mains.lag_us + uniform(mains.jitter_us)) * SIM_TICKS_PER_US;
+    double width = mains.bounce_us * SIM_TICKS_PER_US / (2 * mains.bounce_edges + 1);
+    uint32_t i;
+
+    if (crossing_count == crossing_size) {
+        crossing_size = crossing_size ? 2 * crossing_size : 1024;
+        crossings = realloc(crossings, crossing_size * sizeof(*crossings));
+    }
+    crossings[crossing_count++] = mains.next;
+    relay.crossing[0] = relay.crossing[1];
+    relay.crossing[1] = mains.next;
+
+    edge_count = edge_next = 0;
+    edge_add(start, true);
+    for (i = 0; i < mains.bounce_edges; i++) {
+        edge_add(start + (2 * i + 1) * width + uniform(width / 4), false);
+        edge_add(start + (2 * i + 2) * width + uniform(width / 4), true);
+    }
+    edge_add(start + fmax(mains.pulse_us * SIM_TICKS_PER_US, (2 * i + 2) * width), false);
+    if (mains.glitch_us) {
+        edge_add(mains.next + mains.glitch_us * SIM_TICKS_PER_US, true);
+        edge_add(mains.next + (mains.glitch_us + 50) * SIM_TICKS_PER_US, false);
+        mains.glitch_us = 0;
+    }
+
+    mains.next += 500000.0 / mains.hz * SIM_TICKS_PER_US;
+    mains.hz += mains.drift * 0.5 / mains.hz;
+}
+
+/* Contacts follow the coil after the real delay; measure them against
+ * the nearest real crossing */
+static void relay_contact(void)
+{
+    double contact = relay.contact, error;
+
+    error = fmin(fmin(fabs(contact - relay.crossing[0]), fabs(contact - relay.crossing[1])),
+            fabs(contact - mains.next)) / SIM_TICKS_PER_US;
+
+    relay.contact_pending = false;
+    relay.switches++;
+    relay.error_us += error;
+    if (error > relay.error_max_us)
+        relay.error_max_us = error;
+    if (relay.sense)
+        relay_sensed(relay.index, relay.coil, (uint32_t)relay.contact);
+}
+
+static void relay_coil(void)
+{
+    uint32_t count;
+    const sim_edge_t *edges;
+
+    if (relay.index < 0 || gpio_read(relay.gpio) == relay.coil)
+        return;
+    edges = sim_trace(relay.gpio, &count);
+    relay.coil = !relay.coil;
+    relay.contact = (count ? edges[count - 1].time : sim_now)
+            + SIM_US(relay.delay_us[relay.coil]);
+    relay.contact_pending = true;
+}
+
+/* Advance the virtual hardware, the detector and the relay up to time t */
+static void mains_run_until(uint64_t t)
+{
+    for (;;) {
+        relay_coil();
+        if (edge_next == edge_count && mains.hz && mains.next <= t)
+            mains_crossing();
+        if (relay.contact_pending && relay.contact <= t
+                && (edge_next == edge_count || relay.contact < edges[edge_next].time)
+                && (!mains.hz || relay.contact < mains.next)) {
+            sim_run_until(relay.contact);
+            relay_contact();
+            continue;
+        }
+        if (!mains.hz && sim_now < t) {
+            /* no crossings to stop at, pick up coil edges made by timers */
+            sim_run_until(sim_now + SIM_MS(1) < t ? sim_now + SIM_MS(1) : t);
+            continue;
+        }
+        if (edge_next == edge_count || edges[edge_next].time > t)
+            break;
+        sim_run_until(edges[edge_next].time);
+        sim_gpio_input(ZEROCROSS_GPIO, edges[edge_next].level);
+        edge_next++;
+    }
+    sim_run_until(t);
+    relay_coil();
+}
+
+/* Firing angle of every complete half-cycle from real crossing first on */
+static void measure(int channel, uint32_t first, bool level, firing_t *f)
+{
+    uint32_t count, i = 0, k;
+    const sim_edge_t *edges = sim_trace(channel_gpio[channel], &count);
+    double sum = 0, sum2 = 0, power = 0;
+
+    memset(f, 0, sizeof(*f));
+    for (k = 0; k + 1 < crossing_count; k++) {
+        uint64_t start = crossings[k], end = crossings[k + 1];
+        double half = end - start, angle = 180;
+        bool released = false;
+
+        for (; i < count && edges[i].time <= start; i++)
+            level = edges[i].level;
+        /* gate high at the crossing: the triac conducts from the start */
+        if (level)
+            angle = 0;
+        for (; i < count && edges[i].time < end; i++) {
+            level = edges[i].level;
+            if (!level)
+                released = true;
+            else if (angle == 180)
+                angle = 180.0 * (edges[i].time - start) / half;
+        }
+        if (k < first)
+            continue;
+
+        f->half_cycles++;
+        /* a gate pulse running into the crossing, not a full-on gate */
+        if (angle == 0 && released)
+            f->overlaps++;
+        if (angle < 180) {
+            double a = angle * M_PI / 180;
+            f->fired++;
+            sum += angle;
+            sum2 += angle * angle;
+            power += 1.0 - a / M_PI + sin(2.0 * a) / (2.0 * M_PI);
+        }
+        if (trace)
+            fprintf(trace, "%.3f,%.1f,%d,%.2f\n", (double)start / SIM_MS(1),
+                    half / SIM_TICKS_PER_US, channel, angle);
+    }
+    if (f->fired) {
+        f->angle = sum / f->fired;
+        f->jitter = sqrt(fabs(sum2 / f->fired - f->angle * f->angle));
+    }
+    if (f->half_cycles)
+        f->power = power / f->half_cycles;
+}
+
+/* Run for ms and measure every channel, skipping the first half-cycles */
+static void run(double ms)
+{
+    zerocross_stats_t before, after;
+    bool level[TRIAC_MAX_CHANNELS];
+    int ch;
+
+    sim_trace_clear();
+    for (ch = 0; ch < channel_count; ch++)
+        level[ch] = gpio_read(channel_gpio[ch]);
+    crossing_count = 0;
+    relay.switches = 0;
+    relay.error_us = relay.error_max_us = 0;
+    zerocross_get_stats(&before);
+
+    mains_run_until(sim_now + SIM_US(ms * 1000));
+
+    zerocross_get_stats(&after);
+    last.zc.irq_count = after.irq_count - before.irq_count;
+    last.zc.crossings = after.crossings - before.crossings;
+    last.zc.glitches = after.glitches - before.glitches;
+    last.crossings = crossing_count;
+    for (ch = 0; ch < channel_count; ch++)
+        measure(ch, SETTLE_HALF_CYCLES, level[ch], &last.channels[ch]);
+}
+
+static void report(void)
+{
+    triac_stats_t stats;
+    int ch;
+
+    triac_get_stats(&stats);
+    printf("%8.1f ms: %u crossings, %u accepted of %u edges, %u glitches,"
+            " %uHz %uus %slocked\n",
+            (double)sim_now / SIM_MS(1), last.crossings, last.zc.crossings,
+            last.zc.irq_count, last.zc.glitches, zerocross_mains_hz(),
+            zerocross_half_period_us(), zerocross_locked() ? "" : "un");
+    printf("  triac: %u missed firings, events up to %u us late\n",
+            stats.missed, stats.late_max_us);
+    if (relay.index >= 0) {
+        uint32_t close_us, open_us;
+        relay_get_delays(relay.index, &close_us, &open_us);
+        printf("  relay: %u switches, contact %.1f us (max %.1f) from a crossing,"
+                " learned close %u us, open %u us\n", relay.switches,
+                relay.switches ? relay.error_us / relay.switches : 0,
+                relay.error_max_us, close_us, open_us);
+    }
+    for (ch = 0; ch < channel_count; ch++) {
+        firing_t *f = &last.channels[ch];
+        printf("  channel %d at %3u: %u/%u fired, angle %6.2f deg (jitter %.2f),"
+                " power %6.2f %%, rms %6.2f %%, %u overlaps\n",
+                ch, channel_brightness[ch], f->fired, f->half_cycles, f->angle,
+                f->jitter, 100 * f->power, 100 * sqrt(f->power), f->overlaps);
+    }
+}
+
+static int expect(const char *what, double value, double lo, double hi)
+{
+    if (value >= lo && value <= hi)
+        return 0;
+    printf("  FAIL: %s %.3f not in [%.3f, %.3f]\n", what, value, lo, hi);
+    return 1;
+}
+
+static firing_t *channel_arg(const char *line, int lineno)
+{
+    int ch = -1;
+
+    sscanf(line, "%*s %*s %d", &ch);
+    if (ch < 0 || ch >= channel_count) {
+        fprintf(stderr, "line %d: bad channel\n", lineno);
+        return NULL;
+    }
+    return &last.channels[ch];
+}
+
+int main(int argc, char **argv)
+{
+    FILE *script = stdin;
+    char line[256], cmd[32], what[32];
+    double a, b, c, d, e;
+    int failed = 0, lineno = 0;
+    uint64_t simulated = 0;
+    clock_t started = clock();
+
+    if (argc > 1 && !(script = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    sim_reset();
+    dimmer_curve_init(dimmer_curve_power_linear);
+    zerocross_tracker_init();
+    triac_init();
+    gpio_enable(ZEROCROSS_GPIO, GPIO_INPUT);
+    gpio_set_interrupt(ZEROCROSS_GPIO, GPIO_INTTYPE_EDGE_POS, zerocross_intr);
+    mains.next = SIM_MS(1);
+
+    while (fgets(line, sizeof(line), script)) {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        lineno++;
+        if (sscanf(line, "%31s", cmd) != 1)
+            continue;
+
+        if (!strcmp(cmd, "mains")) {
+            b = 0;
+            sscanf(line, "%*s %lf %lf", &a, &b);
+            /* back from an outage */
+            if (!mains.hz)
+                mains.next = sim_now + SIM_MS(1);
+            mains.hz = a;
+            mains.drift = b;
+        } else if (!strcmp(cmd, "jitter")) {
+            sscanf(line, "%*s %lf", &mains.jitter_us);
+        } else if (!strcmp(cmd, "bounce")) {
+            sscanf(line, "%*s %lf %lf", &a, &mains.bounce_us);
+            mains.bounce_edges = a < 0 ? 0 : a > 64 ? 64 : a;
+        } else if (!strcmp(cmd, "detector")) {
+            b = 0;
+            sscanf(line, "%*s %lf %lf", &a, &b);
+            mains.pulse_us = a;
+            mains.lag_us = b;
+        } else if (!strcmp(cmd, "glitch")) {
+            sscanf(line, "%*s %lf", &mains.glitch_us);
+        } else if (!strcmp(cmd, "latency")) {
+            b = 0;
+            sscanf(line, "%*s %lf %lf", &a, &b);
+            sim_isr_latency = SIM_US(a);
+            sim_isr_jitter = SIM_US(b);
+        } else if (!strcmp(cmd, "curve")) {
+            sscanf(line, "%*s %31s", what);
+            dimmer_curve_init(!strcmp(what, "phase") ? dimmer_curve_phase_linear
+                    : !strcmp(what, "perceptual") ? dimmer_curve_perceptual
+                    : dimmer_curve_power_linear);
+        } else if (!strcmp(cmd, "channel")) {
+            sscanf(line, "%*s %lf", &a);
+            if (triac_channel_create(a, false) < 0) {
+                fprintf(stderr, "line %d: cannot create channel\n", lineno);
+                failed++;
+            } else {
+                channel_gpio[channel_count++] = a;
+            }
+        } else if (!strcmp(cmd, "fade")) {
+            sscanf(line, "%*s %lf", &a);
+            triac_set_fade(a);
+        } else if (!strcmp(cmd, "lag")) {
+            sscanf(line, "%*s %lf", &a);
+            triac_set_lag(a);
+        } else if (!strcmp(cmd, "set")) {
+            sscanf(line, "%*s %lf %lf", &a, &b);
+            if (a >= 0 && a < channel_count) {
+                channel_brightness[(int)a] = b;
+                triac_channel_set(a, b > 0, b);
+            }
+        } else if (!strcmp(cmd, "relay")) {
+            sscanf(line, "%*s %lf %lf %lf", &a, &b, &c);
+            if (relay.index < 0)
+                relay.index = relay_create(a, false);
+            relay.gpio = a;
+            relay.delay_us[true] = b;
+            relay.delay_us[false] = c;
+        } else if (!strcmp(cmd, "sense")) {
+            sscanf(line, "%*s %lf", &a);
+            relay.sense = a;
+        } else if (!strcmp(cmd, "switch")) {
+            sscanf(line, "%*s %lf", &a);
+            relay_set(relay.index, a);
+        } else if (!strcmp(cmd, "trace")) {
+            sscanf(line, "%*s %31s", what);
+            if (trace)
+                fclose(trace);
+            if ((trace = fopen(what, "w")))
+                fprintf(trace, "time_ms,half_period_us,channel,angle_deg\n");
+            else
+                perror(what);
+        } else if (!strcmp(cmd, "run")) {
+            uint64_t from = sim_now;
+            sscanf(line, "%*s %lf", &a);
+            run(a);
+            simulated += sim_now - from;
+            report();
+        } else if (!strcmp(cmd, "sweep")) {
+            uint64_t from = sim_now;
+            int ch;
+            sscanf(line, "%*s %lf %lf %lf %lf %lf", &a, &b, &c, &d, &e);
+            ch = a;
+            if (ch < 0 || ch >= channel_count || d <= 0) {
+                fprintf(stderr, "line %d: bad sweep\n", lineno);
+                failed++;
+                continue;
+            }
+            printf("brightness  angle deg  jitter deg  power %%  rms %%\n");
+            for (; b <= c; b += d) {
+                channel_brightness[ch] = b;
+                triac_channel_set(ch, b > 0, b);
+                run(e);
+                printf("%10.0f %10.2f %11.2f %8.2f %6.2f\n", b,
+                        last.channels[ch].angle, last.channels[ch].jitter,
+                        100 * last.channels[ch].power,
+                        100 * sqrt(last.channels[ch].power));
+            }
+            simulated += sim_now - from;
+        } else if (!strcmp(cmd, "expect")) {
+            firing_t *f;
+            a = b = c = 0;
+            if (sscanf(line, "%*s %31s %lf", what, &a) < 1) {
+                fprintf(stderr, "line %d: bad expect\n", lineno);
+                failed++;
+            } else if (!strcmp(what, "hz")) {
+                failed += expect(what, zerocross_mains_hz(), a, a);
+            } else if (!strcmp(what, "locked")) {
+                failed += expect(what, zerocross_locked(), a, a);
+            } else if (!strcmp(what, "late")) {
+                triac_stats_t stats;
+                triac_get_stats(&stats);
+                failed += expect(what, stats.late_max_us, 0, a);
+            } else if (!strcmp(what, "contact")) {
+                failed += expect(what, relay.error_max_us, 0, a);
+            } else if (!strcmp(what, "switches")) {
+                failed += expect(what, relay.switches, a, a);
+            } else if (!strcmp(what, "immediate")) {
+                relay_stats_t stats;
+                relay_get_stats(&stats);
+                failed += expect(what, stats.immediate, a, a);
+            } else if (!strcmp(what, "close") || !strcmp(what, "open")) {
+                uint32_t delay[2];
+                sscanf(line, "%*s %*s %*s %lf", &b);
+                relay_get_delays(relay.index, &delay[true], &delay[false]);
+                failed += expect(what, delay[!strcmp(what, "close")], a - b, a + b);
+            } else if (!strcmp(what, "missed")) {
+                failed += expect(what, abs((int)last.crossings - (int)last.zc.crossings), 0, a);
+            } else if (!(f = channel_arg(line, lineno))) {
+                failed++;
+            } else {
+                sscanf(line, "%*s %*s %*s %lf %lf", &b, &c);
+                if (!strcmp(what, "angle")) {
+                    failed += expect(what, f->angle, b - c, b + c);
+                } else if (!strcmp(what, "jitter")) {
+                    failed += expect(what, f->jitter, 0, b);
+                } else if (!strcmp(what, "power")) {
+                    failed += expect(what, 100 * f->power, b - c, b + c);
+                } else if (!strcmp(what, "overlaps")) {
+                    failed += expect(what, f->overlaps, 0, b);
+                } else {
+                    fprintf(stderr, "line %d: unknown expect %s\n", lineno, what);
+                    failed++;
+                }
+            }
+        } else {
+            fprintf(stderr, "line %d: unknown command %s\n", lineno, cmd);
+            failed++;
+        }
+    }
+    if (trace)
+        fclose(trace);
+
+    printf("simulated %.1f ms in %.1f ms, %d failed\n",
+            (double)simulated / SIM_MS(1),
+            1000.0 * (clock() - started) / CLOCKS_PER_SEC, failed);
+    return failed;
+}
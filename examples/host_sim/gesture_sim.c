@@ -0,0 +1,251 @@
+/*
+ * Runs ../dimmer/gesture.c behind the debounce of ../dimmer/button.c on
+ * the virtual hardware of sim.c, for scripted or recorded press traces
+ * on an active-low button at GPIO0.
+ *
+ * Script commands, one per line ('#' starts a comment):
+ *   gestures <hold ms> <gap ms> <repeat ms> <max clicks>
+ *                                gesture timing, restarts the button
+ *   bounce <ms>                  contact bounce on every edge (default 1)
+ *   invert <0|1>                 input.h runtime inversion of the button,
+ *                                pressed at high level with 1
+ *   press <ms> | release <ms>    hold the button down or up
+ *   trace <ms>...                recorded durations, alternately down
+ *                                and up, starting with down
+ *   expect <event>...            the gestures since the last expect, as
+ *                                click<n>, hold<n>, repeat<n>, release<n>
+ *                                with n the clicks before; "*<count>" for
+ *                                repeated events, "none" for no events
+ *   expect held <ms> <tol ms>    length of the last press reported
+ *   expect latency <stage> <ms> <tol ms>
+ *                                mean of a latency.h stage since the last
+ *                                check, "debounce" or "callback"
+ *
+ * The exit status is the number of failed expectations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "button.h"
+#include "latency.h"
+#include "input.h"
+#include <sysparam.h>
+
+#define BUTTON_GPIO 0
+#define MAX_EVENTS 256
+
+static const char *names[] = {
+    [GESTURE_CLICK] = "click",
+    [GESTURE_HOLD] = "hold",
+    [GESTURE_REPEAT] = "repeat",
+    [GESTURE_RELEASE] = "release",
+};
+
+static gesture_config_t config = {
+    .sample_ms = BUTTON_SAMPLE_MS,
+    .hold_ms = 1000,
+    .gap_ms = 300,
+    .repeat_ms = 100,
+    .max_clicks = 2,
+};
+
+static gesture_event_t events[MAX_EVENTS];
+static uint32_t event_count, held_ms;
+static double bounce_ms = 1;
+static bool level = true;
+/* pressed at high level, after "invert 1" */
+static bool active_high;
+static FILE *out;
+/* histograms at the last latency check */
+static latency_histogram_t latency_seen[LATENCY_STAGES];
+
+static void button_gesture(uint8_t gpio_num, const gesture_event_t *event)
+{
+    held_ms = event->held_ms;
+    if (event_count < MAX_EVENTS)
+        events[event_count++] = *event;
+    /* repeats are only counted */
+    if (event->type == GESTURE_REPEAT)
+        return;
+    fprintf(out, "%8.1f ms: %s%u", (double)sim_now / SIM_MS(1),
+            names[event->type], event->clicks);
+    if (event->type == GESTURE_RELEASE || event->type == GESTURE_CLICK)
+        fprintf(out, " (held %u ms)", event->held_ms);
+    fprintf(out, "\n");
+}
+
+static void button_restart(void)
+{
+    button_delete(BUTTON_GPIO);
+    if (button_create(BUTTON_GPIO, false, NULL)
+            || button_set_gestures(BUTTON_GPIO, &config, button_gesture))
+        fprintf(out, "button setup failed\n");
+}
+
+/* sets the contact level after bouncing, then keeps it for ms */
+static void contact(bool down, double ms)
+{
+    uint64_t end = sim_now + SIM_US(ms * 1000);
+    bool settled = (down == active_high);
+
+    if (bounce_ms > 0 && level != settled) {
+        sim_gpio_input(BUTTON_GPIO, settled);
+        sim_run_until(sim_now + SIM_US(bounce_ms * 300));
+        sim_gpio_input(BUTTON_GPIO, !settled);
+        sim_run_until(sim_now + SIM_US(bounce_ms * 400));
+    }
+    level = settled;
+    sim_gpio_input(BUTTON_GPIO, level);
+    sim_run_until(end);
+}
+
+/* mean latency of stage in ms since the last check, -1 without traces */
+static double latency_mean(latency_stage_t stage)
+{
+    latency_histogram_t now;
+    uint32_t count;
+    double mean;
+
+    latency_get_histogram(stage, &now);
+    count = now.count - latency_seen[stage].count;
+    mean = count ? (double)(now.sum_us - latency_seen[stage].sum_us) / count / 1000 : -1;
+    latency_seen[stage] = now;
+    return mean;
+}
+
+/* the events since the last expect, repeated ones folded into "*n" */
+static void events_format(char *buf, size_t size)
+{
+    uint32_t i, n;
+    size_t len = 0;
+
+    buf[0] = 0;
+    for (i = 0; i < event_count; i += n) {
+        for (n = 1; i + n < event_count
+                && events[i + n].type == events[i].type
+                && events[i + n].clicks == events[i].clicks; n++)
+            ;
+        len += snprintf(buf + len, size - len, "%s%s%u", len ? " " : "",
+                names[events[i].type], events[i].clicks);
+        if (n > 1)
+            len += snprintf(buf + len, size - len, "*%u", n);
+        if (len >= size)
+            break;
+    }
+    if (!event_count)
+        snprintf(buf, size, "none");
+}
+
+int main(int argc, char **argv)
+{
+    FILE *script = stdin;
+    char line[512], cmd[32], got[1024], want[512], *p, *tok;
+    double a, b, c, d;
+    int failed = 0, lineno = 0, offset;
+    bool down;
+    clock_t started = clock();
+
+    if (argc > 1 && !(script = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    /* button.c reports every press on stdout */
+    fflush(stdout);
+    out = fdopen(dup(1), "w");
+    if (!out || !freopen("/dev/null", "w", stdout))
+        return 1;
+
+    sim_reset();
+    sim_gpio_input(BUTTON_GPIO, level);
+    button_restart();
+
+    while (fgets(line, sizeof(line), script)) {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        lineno++;
+        if (sscanf(line, "%31s", cmd) != 1)
+            continue;
+
+        if (!strcmp(cmd, "gestures")) {
+            if (sscanf(line, "%*s %lf %lf %lf %lf", &a, &b, &c, &d) != 4) {
+                fprintf(out, "line %d: bad gestures\n", lineno);
+                failed++;
+                continue;
+            }
+            config.hold_ms = a;
+            config.gap_ms = b;
+            config.repeat_ms = c;
+            config.max_clicks = d;
+            button_restart();
+        } else if (!strcmp(cmd, "bounce")) {
+            sscanf(line, "%*s %lf", &bounce_ms);
+        } else if (!strcmp(cmd, "invert")) {
+            int32_t saved = 0;
+
+            sscanf(line, "%*s %lf", &a);
+            active_high = a != 0;
+            if (input_config_set(BUTTON_GPIO, active_high, true)
+                    || sysparam_get_int32("input.inverted", &saved)
+                    || ((saved >> BUTTON_GPIO) & 1) != active_high) {
+                fprintf(out, "line %d: inversion not saved\n", lineno);
+                failed++;
+            }
+        } else if (!strcmp(cmd, "press") || !strcmp(cmd, "release")) {
+            sscanf(line, "%*s %lf", &a);
+            contact(!strcmp(cmd, "press"), a);
+        } else if (!strcmp(cmd, "trace")) {
+            p = line + strlen("trace");
+            for (down = true; sscanf(p, "%lf%n", &a, &offset) == 1; down = !down) {
+                contact(down, a);
+                p += offset;
+            }
+        } else if (!strcmp(cmd, "expect")) {
+            if (sscanf(line, "%*s latency %31s %lf %lf", cmd, &a, &b) == 3) {
+                latency_stage_t stage = !strcmp(cmd, "debounce")
+                    ? LATENCY_DEBOUNCED : LATENCY_CALLBACK;
+                c = latency_mean(stage);
+                fprintf(out, "  latency %s: mean %.1f ms\n", cmd, c);
+                if (c < a - b || c > a + b) {
+                    fprintf(out, "  FAIL: %s latency not in [%.0f, %.0f] ms\n",
+                            cmd, a - b, a + b);
+                    failed++;
+                }
+                continue;
+            }
+            if (sscanf(line, "%*s held %lf %lf", &a, &b) == 2) {
+                if (held_ms < a - b || held_ms > a + b) {
+                    fprintf(out, "  FAIL: held %u ms not in [%.0f, %.0f]\n",
+                            held_ms, a - b, a + b);
+                    failed++;
+                }
+                continue;
+            }
+            want[0] = 0;
+            for (tok = strtok(line + strlen("expect"), " \t\r\n"); tok;
+                    tok = strtok(NULL, " \t\r\n"))
+                snprintf(want + strlen(want), sizeof(want) - strlen(want),
+                        "%s%s", want[0] ? " " : "", tok);
+            events_format(got, sizeof(got));
+            if (strcmp(got, want)) {
+                fprintf(out, "  FAIL: got '%s', expected '%s'\n", got, want);
+                failed++;
+            }
+            event_count = 0;
+        } else {
+            fprintf(out, "line %d: unknown command %s\n", lineno, cmd);
+            failed++;
+        }
+    }
+
+    fprintf(out, "simulated %.1f ms in %.1f ms, %d failed\n",
+            (double)sim_now / SIM_MS(1),
+            1000.0 * (clock() - started) / CLOCKS_PER_SEC, failed);
+    fclose(out);
+    return failed;
+}
@@ -0,0 +1,26 @@
+/* Host simulation stand-in for FreeRTOS.h, see ../sim.h */
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IRAM
+#define IRAM_DATA
+#define BIT(x) (1UL << (x))
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 10
+#define pdMS_TO_TICKS(ms) ((ms) / portTICK_PERIOD_MS)
+
+#endif
@@ -0,0 +1,46 @@
+/* Host simulation stand-in for esp/gpio.h, see ../../sim.h */
+#ifndef SIM_ESP_GPIO_H
+#define SIM_ESP_GPIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    GPIO_INPUT,
+    GPIO_OUTPUT,
+    GPIO_OUT_OPEN_DRAIN,
+} gpio_direction_t;
+
+typedef enum {
+    GPIO_INTTYPE_NONE,
+    GPIO_INTTYPE_EDGE_POS,
+    GPIO_INTTYPE_EDGE_NEG,
+    GPIO_INTTYPE_EDGE_ANY,
+    GPIO_INTTYPE_LEVEL_LOW,
+    GPIO_INTTYPE_LEVEL_HIGH,
+} gpio_inttype_t;
+
+typedef void (*gpio_interrupt_handler_t)(uint8_t gpio_num);
+
+/* GPIO0..15 registers. Output writes are not seen as they happen: sim.c
+ * applies them when the interrupt handler (or sim_run_until()) returns,
+ * so each handler should write OUT_SET and OUT_CLEAR at most once. IN
+ * holds the level of every pin. */
+typedef struct {
+    volatile uint32_t OUT;
+    volatile uint32_t OUT_SET;
+    volatile uint32_t OUT_CLEAR;
+    volatile uint32_t IN;
+} sim_gpio_regs_t;
+
+extern sim_gpio_regs_t sim_gpio_regs;
+#define GPIO sim_gpio_regs
+
+void gpio_enable(const uint8_t gpio_num, const gpio_direction_t direction);
+void gpio_write(const uint8_t gpio_num, const bool set);
+bool gpio_read(const uint8_t gpio_num);
+void gpio_set_pullup(uint8_t gpio_num, bool enabled, bool enabled_during_sleep);
+void gpio_set_interrupt(const uint8_t gpio_num, const gpio_inttype_t int_type,
+        gpio_interrupt_handler_t handler);
+
+#endif
@@ -0,0 +1,32 @@
+/* Host simulation stand-in for esp/timer.h, see ../../sim.h */
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    FRC1 = 0,
+    FRC2 = 1,
+} timer_frc_t;
+
+typedef enum {
+    TIMER_CLKDIV_1 = 0,
+    TIMER_CLKDIV_16 = 4,
+    TIMER_CLKDIV_256 = 8,
+} timer_clkdiv_t;
+
+#define INUM_TIMER_FRC1 9
+
+void timer_set_divider(const timer_frc_t frc, const timer_clkdiv_t div);
+void timer_set_load(const timer_frc_t frc, const uint32_t load);
+uint32_t timer_get_load(const timer_frc_t frc);
+void timer_set_reload(const timer_frc_t frc, const bool reload);
+void timer_set_interrupts(const timer_frc_t frc, bool enable);
+void timer_set_run(const timer_frc_t frc, const bool run);
+uint32_t timer_time_to_count(const timer_frc_t frc, uint32_t us, const timer_clkdiv_t div);
+int timer_set_frequency(const timer_frc_t frc, uint32_t freq);
+
+void _xt_isr_attach(uint8_t inum, void (*handler)(void *), void *arg);
+
+#endif
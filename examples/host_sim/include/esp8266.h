@@ -0,0 +1,9 @@
+/* Host simulation stand-in for esp8266.h, see ../sim.h */
+#ifndef SIM_ESP8266_H
+#define SIM_ESP8266_H
+
+#include <FreeRTOS.h>
+#include <esp/gpio.h>
+#include <esp/timer.h>
+
+#endif
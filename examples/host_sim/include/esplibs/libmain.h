@@ -0,0 +1,5 @@
+/* Host simulation stand-in for esplibs/libmain.h, see ../../sim.h */
+#ifndef SIM_ESPLIBS_LIBMAIN_H
+#define SIM_ESPLIBS_LIBMAIN_H
+
+#endif
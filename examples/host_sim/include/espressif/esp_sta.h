@@ -0,0 +1,15 @@
+/* Host simulation stand-in for espressif/esp_sta.h, see ../../sim.h */
+#ifndef SIM_ESP_STA_H
+#define SIM_ESP_STA_H
+
+#include <stdint.h>
+
+#define STATION_GOT_IP 5
+
+/* always connected */
+static inline uint8_t sdk_wifi_station_get_connect_status(void)
+{
+    return STATION_GOT_IP;
+}
+
+#endif
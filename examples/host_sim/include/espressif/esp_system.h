@@ -0,0 +1,13 @@
+/* Host simulation stand-in, see ../../sim.h */
+#ifndef SIM_ESP_SYSTEM_H
+#define SIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+/* CPU clock in MHz, matches xthal_get_ccount() */
+static inline uint8_t sdk_system_get_cpu_freq(void)
+{
+    return 80;
+}
+
+#endif
@@ -0,0 +1,5 @@
+/* Host simulation stand-in for espressif/esp_wifi.h, see ../../sim.h */
+#ifndef SIM_ESP_WIFI_H
+#define SIM_ESP_WIFI_H
+
+#endif
@@ -0,0 +1,2 @@
+/* Host simulation stand-in, see ../../sim.h */
+#include <FreeRTOS.h>
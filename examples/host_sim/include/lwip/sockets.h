@@ -0,0 +1,41 @@
+/* Host simulation stand-in for lwip/sockets.h, see ../../sim.h */
+#ifndef SIM_LWIP_SOCKETS_H
+#define SIM_LWIP_SOCKETS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* lwIP's own layout, with sin_len; the host's socket headers are not used */
+struct in_addr {
+    uint32_t s_addr;
+};
+
+struct sockaddr {
+    uint8_t sa_len;
+    uint8_t sa_family;
+    char sa_data[14];
+};
+
+struct sockaddr_in {
+    uint8_t sin_len;
+    uint8_t sin_family;
+    uint16_t sin_port;
+    struct in_addr sin_addr;
+    char sin_zero[8];
+};
+
+#define AF_INET 2
+#define SOCK_DGRAM 2
+#define INADDR_ANY 0x00000000UL
+#define INADDR_BROADCAST 0xffffffffUL
+
+#define htonl(x) __builtin_bswap32(x)
+#define htons(x) __builtin_bswap16(x)
+
+/* Implemented by the simulation that links a networking driver */
+int lwip_socket(int domain, int type, int protocol);
+int lwip_bind(int s, const struct sockaddr *name, int namelen);
+int lwip_sendto(int s, const void *data, size_t size, int flags,
+        const struct sockaddr *to, int tolen);
+
+#endif
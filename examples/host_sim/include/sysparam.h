@@ -0,0 +1,16 @@
+/* Host simulation stand-in for sysparam.h, kept in memory, see ../sim.h */
+#ifndef SIM_SYSPARAM_H
+#define SIM_SYSPARAM_H
+
+#include <stdint.h>
+
+typedef enum {
+    SYSPARAM_OK = 0,
+    SYSPARAM_NOTFOUND = 1,
+    SYSPARAM_ERR_FULL = -2,
+} sysparam_status_t;
+
+sysparam_status_t sysparam_get_int32(const char *key, int32_t *result);
+sysparam_status_t sysparam_set_int32(const char *key, int32_t value);
+
+#endif
@@ -0,0 +1,42 @@
+/* Host simulation stand-in for task.h, see ../sim.h */
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "FreeRTOS.h"
+
+/* There is only one thread and interrupts run synchronously */
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+/* FreeRTOS ticks of portTICK_PERIOD_MS on the virtual clock */
+extern uint64_t sim_now;
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return sim_now / (80000ULL * portTICK_PERIOD_MS);
+}
+
+#define xTaskGetTickCountFromISR xTaskGetTickCount
+
+/* Tasks are not run; drivers that need one fail to initialize */
+typedef void *TaskHandle_t;
+
+static inline BaseType_t xTaskCreate(void (*task)(void *), const char *name,
+        uint16_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    return pdFALSE;
+}
+
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+/* Only for the body in sim_task_run(), see ../sim.h; notifications
+ * are for that task, whichever handle is given */
+void vTaskDelay(TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+static inline void vTaskSuspendAll(void) {}
+static inline BaseType_t xTaskResumeAll(void) { return pdFALSE; }
+
+#endif
@@ -0,0 +1,30 @@
+/* Host simulation stand-in for timers.h, see ../sim.h */
+#ifndef SIM_TIMERS_H
+#define SIM_TIMERS_H
+
+#include "FreeRTOS.h"
+
+/* Software timers run from sim_run_until() on FreeRTOS tick boundaries,
+ * outside interrupt context. Commands take effect immediately. */
+typedef void *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+typedef void (*PendedFunction_t)(void *param1, uint32_t param2);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload,
+        void *id, TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+/* runs function at once, as the command queue is empty */
+BaseType_t xTimerPendFunctionCall(PendedFunction_t function, void *param1,
+        uint32_t param2, TickType_t wait);
+
+#define xTimerStartFromISR(timer, woken) xTimerStart((timer), 0)
+#define xTimerStopFromISR(timer, woken) xTimerStop((timer), 0)
+/* starting a running timer restarts it, as FreeRTOS does */
+#define xTimerReset(timer, wait) xTimerStart((timer), (wait))
+#define xTimerResetFromISR(timer, woken) xTimerStart((timer), 0)
+
+#endif
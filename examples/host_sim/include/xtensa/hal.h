@@ -0,0 +1,15 @@
+/* Host simulation stand-in for xtensa/hal.h, see ../../sim.h */
+#ifndef SIM_XTENSA_HAL_H
+#define SIM_XTENSA_HAL_H
+
+#include <stdint.h>
+
+extern uint64_t sim_now;
+
+/* The simulated CPU runs at 80MHz, one cycle per virtual tick */
+static inline uint32_t xthal_get_ccount(void)
+{
+    return (uint32_t)sim_now;
+}
+
+#endif
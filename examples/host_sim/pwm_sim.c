@@ -0,0 +1,135 @@
+/*
+ * Runs ../sonoff_basic_pwm/pwm.c on the virtual hardware of sim.c and
+ * measures the resulting waveform for a scripted duty/frequency sequence.
+ *
+ * Script commands, one per line ('#' starts a comment):
+ *   latency <us> [<jitter us>]   interrupt entry latency
+ *   glitch <us>                  pulses shorter than this are glitches
+ *   init <reverse> <gpio>...     pwm_init()
+ *   freq <hz>                    pwm_set_freq()
+ *   duty <0..65535>              pwm_set_duty()
+ *   start | stop                 pwm_start() / pwm_stop()
+ *   run <ms>                     advance time, report the waveform
+ *   expect duty <%> <tol %>      checks on the last report
+ *   expect period <us> <tol us>
+ *   expect jitter <max us>
+ *   expect glitches <max>
+ *
+ * The exit status is the number of failed expectations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "pwm.h"
+
+static uint8_t pwm_pins[MAX_PWM_PINS];
+static uint32_t glitch_ticks = SIM_US(1);
+static uint16_t freq;
+static sim_stats_t last;
+
+static int expect(const char *what, double value, double lo, double hi)
+{
+    if (value >= lo && value <= hi)
+        return 0;
+    printf("  FAIL: %s %.3f not in [%.3f, %.3f]\n", what, value, lo, hi);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *script = stdin;
+    char line[256], cmd[32], what[32];
+    double a, b;
+    int failed = 0, lineno = 0;
+    uint64_t simulated = 0;
+    clock_t started = clock();
+
+    if (argc > 1 && !(script = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    sim_reset();
+
+    while (fgets(line, sizeof(line), script)) {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        lineno++;
+        if (sscanf(line, "%31s", cmd) != 1)
+            continue;
+
+        if (!strcmp(cmd, "latency")) {
+            b = 0;
+            sscanf(line, "%*s %lf %lf", &a, &b);
+            sim_isr_latency = SIM_US(a);
+            sim_isr_jitter = SIM_US(b);
+        } else if (!strcmp(cmd, "glitch")) {
+            sscanf(line, "%*s %lf", &a);
+            glitch_ticks = a * SIM_TICKS_PER_US;
+        } else if (!strcmp(cmd, "init")) {
+            int reverse, n = 0, offset;
+            char *p = line;
+            sscanf(p, "%*s %d%n", &reverse, &offset);
+            p += offset;
+            while (n < MAX_PWM_PINS && sscanf(p, "%lf%n", &a, &offset) == 1) {
+                pwm_pins[n++] = a;
+                p += offset;
+            }
+            pwm_init(n, pwm_pins, reverse);
+        } else if (!strcmp(cmd, "freq")) {
+            sscanf(line, "%*s %lf", &a);
+            freq = a;
+            printf("freq %u Hz: %u bit\n", freq, pwm_set_freq(freq));
+        } else if (!strcmp(cmd, "duty")) {
+            sscanf(line, "%*s %lf", &a);
+            pwm_set_duty(a);
+        } else if (!strcmp(cmd, "start")) {
+            pwm_start();
+        } else if (!strcmp(cmd, "stop")) {
+            pwm_stop();
+        } else if (!strcmp(cmd, "run")) {
+            uint64_t from = sim_now;
+            sscanf(line, "%*s %lf", &a);
+            sim_run_until(sim_now + SIM_US(a * 1000));
+            simulated += sim_now - from;
+            /* skip the first period, it starts wherever the change landed */
+            if (freq)
+                from += SIM_US(1000000 / freq);
+            sim_measure(pwm_pins[0], from, sim_now, glitch_ticks, &last);
+            printf("%8.1f ms: %5u periods %9.3f us (%.3f..%.3f) jitter %.3f us"
+                    " duty %7.3f %% glitches %u\n",
+                    (double)sim_now / SIM_MS(1), last.periods, last.period_us,
+                    last.period_min_us, last.period_max_us, last.jitter_us,
+                    100 * last.duty, last.glitches);
+        } else if (!strcmp(cmd, "expect")) {
+            b = 0;
+            if (sscanf(line, "%*s %31s %lf %lf", what, &a, &b) < 2) {
+                fprintf(stderr, "line %d: bad expect\n", lineno);
+                failed++;
+            } else if (!strcmp(what, "duty")) {
+                failed += expect(what, 100 * last.duty, a - b, a + b);
+            } else if (!strcmp(what, "period")) {
+                failed += expect(what, last.period_us, a - b, a + b);
+            } else if (!strcmp(what, "jitter")) {
+                failed += expect(what, last.jitter_us, 0, a);
+            } else if (!strcmp(what, "glitches")) {
+                failed += expect(what, last.glitches, 0, a);
+            } else {
+                fprintf(stderr, "line %d: unknown expect %s\n", lineno, what);
+                failed++;
+            }
+        } else {
+            fprintf(stderr, "line %d: unknown command %s\n", lineno, cmd);
+            failed++;
+        }
+    }
+
+    printf("simulated %.1f ms in %.1f ms, %d failed\n",
+            (double)simulated / SIM_MS(1),
+            1000.0 * (clock() - started) / CLOCKS_PER_SEC, failed);
+    return failed;
+}
@@ -0,0 +1,589 @@
+/*
+ * Virtual FRC1 timer, GPIO block and interrupt dispatch, see sim.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+#include <esp/gpio.h>
+#include <esp/timer.h>
+#include <sysparam.h>
+#include "sim.h"
+
+uint64_t sim_now;
+uint32_t sim_isr_latency = 160;
+uint32_t sim_isr_jitter = 0;
+uint32_t sim_gpio_cost = 8;
+
+static struct {
+    timer_clkdiv_t div;
+    uint32_t load;
+    bool reload;
+    bool interrupts;
+    bool run;
+    uint64_t expiry;
+} frc1;
+
+static void (*frc1_handler)(void *);
+static void *frc1_arg;
+
+static struct {
+    bool output;
+    bool level;
+    gpio_inttype_t int_type;
+    gpio_interrupt_handler_t handler;
+    sim_edge_t *edges;
+    uint32_t count;
+    uint32_t size;
+} pins[SIM_GPIO_COUNT];
+
+static bool in_isr;
+
+sim_gpio_regs_t sim_gpio_regs;
+/* GPIO.OUT as of the last sim_gpio_sync() */
+static uint32_t gpio_out;
+
+static void sim_gpio_sync(void);
+static void sim_gpio_in(uint8_t gpio_num, bool level);
+
+/* timers.h; kept across sim_reset(), which only stops them */
+typedef struct _sim_timer {
+    TickType_t period;
+    bool reload;
+    void *id;
+    TimerCallbackFunction_t callback;
+    bool active;
+    uint64_t expiry;
+    struct _sim_timer *next;
+} sim_timer_t;
+
+static sim_timer_t *timers;
+
+uint32_t sim_timer_calls;
+uint64_t sim_timer_ns;
+
+/* task.h, one task at a time in sim_task_run() */
+uint32_t sim_task_wakeups;
+uint64_t sim_task_ns;
+static jmp_buf task_exit;
+static uint64_t task_until;
+static struct timespec task_resumed;
+static uint32_t task_notified;
+
+/* sysparam.h, integers only */
+#define SIM_SYSPARAM_COUNT 16
+
+static struct {
+    char key[32];
+    int32_t value;
+} sysparams[SIM_SYSPARAM_COUNT];
+
+void sim_reset(void)
+{
+    uint8_t i;
+
+    sim_trace_clear();
+    for (i = 0; i < SIM_GPIO_COUNT; i++) {
+        free(pins[i].edges);
+        memset(&pins[i], 0, sizeof(pins[i]));
+    }
+    memset(&frc1, 0, sizeof(frc1));
+    memset(&sim_gpio_regs, 0, sizeof(sim_gpio_regs));
+    memset(sysparams, 0, sizeof(sysparams));
+    for (sim_timer_t *timer = timers; timer; timer = timer->next)
+        timer->active = false;
+    sim_timer_calls = 0;
+    sim_timer_ns = 0;
+    sim_task_wakeups = 0;
+    sim_task_ns = 0;
+    task_notified = 0;
+    gpio_out = 0;
+    frc1_handler = NULL;
+    sim_now = 0;
+    srand(1);
+}
+
+static void frc1_arm(void)
+{
+    frc1.expiry = sim_now + ((uint64_t)(frc1.load ? frc1.load : 1) << frc1.div);
+}
+
+static uint64_t isr_entry(uint64_t t)
+{
+    t += sim_isr_latency;
+    if (sim_isr_jitter)
+        t += rand() % (sim_isr_jitter + 1);
+    return t;
+}
+
+static sim_timer_t *sim_timer_next(void)
+{
+    sim_timer_t *timer, *next = NULL;
+
+    for (timer = timers; timer; timer = timer->next)
+        if (timer->active && (!next || timer->expiry < next->expiry))
+            next = timer;
+    return next;
+}
+
+static void sim_timer_run(sim_timer_t *timer)
+{
+    struct timespec start, end;
+
+    if (timer->expiry > sim_now)
+        sim_now = timer->expiry;
+    if (timer->reload)
+        timer->expiry += timer->period * SIM_RTOS_TICK;
+    else
+        timer->active = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    timer->callback(timer);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sim_timer_calls++;
+    sim_timer_ns += (end.tv_sec - start.tv_sec) * 1000000000LL
+        + end.tv_nsec - start.tv_nsec;
+    sim_gpio_sync();
+}
+
+void sim_run_until(uint64_t t)
+{
+    sim_timer_t *timer;
+
+    sim_gpio_sync();
+    for (;;) {
+        uint64_t expiry = frc1.run && frc1.interrupts && frc1_handler
+            ? frc1.expiry : UINT64_MAX;
+
+        /* software timers run in task context, after pending interrupts */
+        timer = sim_timer_next();
+        if (timer && timer->expiry <= t && timer->expiry < expiry) {
+            sim_timer_run(timer);
+            continue;
+        }
+        if (expiry > t)
+            break;
+
+        /* Without auto reload the counter sits at zero until the next
+         * timer_set_load() */
+        if (frc1.reload)
+            frc1.expiry += (uint64_t)frc1.load << frc1.div;
+        else
+            frc1.expiry = UINT64_MAX;
+
+        sim_now = isr_entry(expiry);
+        in_isr = true;
+        frc1_handler(frc1_arg);
+        sim_gpio_sync();
+        in_isr = false;
+    }
+    if (t > sim_now)
+        sim_now = t;
+}
+
+void sim_gpio_input(uint8_t gpio_num, bool level)
+{
+    gpio_inttype_t type;
+    uint64_t now;
+
+    if (gpio_num >= SIM_GPIO_COUNT || pins[gpio_num].level == level)
+        return;
+    pins[gpio_num].level = level;
+    sim_gpio_in(gpio_num, level);
+
+    type = pins[gpio_num].int_type;
+    if (!pins[gpio_num].handler
+            || !(type == GPIO_INTTYPE_EDGE_ANY
+                || (type == GPIO_INTTYPE_EDGE_POS && level)
+                || (type == GPIO_INTTYPE_EDGE_NEG && !level)))
+        return;
+
+    now = sim_now;
+    sim_now = isr_entry(sim_now);
+    in_isr = true;
+    pins[gpio_num].handler(gpio_num);
+    sim_gpio_sync();
+    in_isr = false;
+    /* The caller's notion of time continues where it left off unless
+     * the handler ran past it */
+    if (sim_now < now)
+        sim_now = now;
+}
+
+/* esp/gpio.h */
+
+static void sim_gpio_in(uint8_t gpio_num, bool level)
+{
+    if (gpio_num < 16)
+        sim_gpio_regs.IN = level ? (sim_gpio_regs.IN | (1UL << gpio_num))
+            : (sim_gpio_regs.IN & ~(1UL << gpio_num));
+}
+
+void gpio_enable(const uint8_t gpio_num, const gpio_direction_t direction)
+{
+    if (gpio_num < SIM_GPIO_COUNT)
+        pins[gpio_num].output = direction != GPIO_INPUT;
+}
+
+static void pin_write(const uint8_t gpio_num, const bool set)
+{
+    if (pins[gpio_num].level != set || !pins[gpio_num].count) {
+        if (pins[gpio_num].count == pins[gpio_num].size) {
+            pins[gpio_num].size = pins[gpio_num].size ? 2 * pins[gpio_num].size : 1024;
+            pins[gpio_num].edges = realloc(pins[gpio_num].edges,
+                    pins[gpio_num].size * sizeof(sim_edge_t));
+        }
+        pins[gpio_num].edges[pins[gpio_num].count].time = sim_now;
+        pins[gpio_num].edges[pins[gpio_num].count].level = set;
+        pins[gpio_num].count++;
+    }
+    pins[gpio_num].level = set;
+    sim_gpio_in(gpio_num, set);
+    if (in_isr)
+        sim_now += sim_gpio_cost;
+}
+
+void gpio_write(const uint8_t gpio_num, const bool set)
+{
+    if (gpio_num >= SIM_GPIO_COUNT)
+        return;
+
+    pin_write(gpio_num, set);
+    if (gpio_num < 16) {
+        gpio_out = set ? (gpio_out | (1UL << gpio_num)) : (gpio_out & ~(1UL << gpio_num));
+        sim_gpio_regs.OUT = gpio_out;
+    }
+}
+
+/* Apply what was written to the GPIO registers since the last call */
+static void sim_gpio_sync(void)
+{
+    uint32_t out = sim_gpio_regs.OUT, changed;
+    uint8_t i;
+
+    out = (out | sim_gpio_regs.OUT_SET) & ~sim_gpio_regs.OUT_CLEAR;
+    sim_gpio_regs.OUT_SET = 0;
+    sim_gpio_regs.OUT_CLEAR = 0;
+
+    changed = out ^ gpio_out;
+    for (i = 0; i < 16; i++)
+        if ((changed & (1UL << i)) && pins[i].output)
+            pin_write(i, out & (1UL << i));
+    gpio_out = sim_gpio_regs.OUT = out;
+}
+
+bool gpio_read(const uint8_t gpio_num)
+{
+    return gpio_num < SIM_GPIO_COUNT && pins[gpio_num].level;
+}
+
+void gpio_set_pullup(uint8_t gpio_num, bool enabled, bool enabled_during_sleep)
+{
+}
+
+void gpio_set_interrupt(const uint8_t gpio_num, const gpio_inttype_t int_type,
+        gpio_interrupt_handler_t handler)
+{
+    if (gpio_num >= SIM_GPIO_COUNT)
+        return;
+    pins[gpio_num].int_type = int_type;
+    pins[gpio_num].handler = int_type == GPIO_INTTYPE_NONE ? NULL : handler;
+}
+
+/* esp/timer.h, FRC1 only */
+
+void timer_set_divider(const timer_frc_t frc, const timer_clkdiv_t div)
+{
+    frc1.div = div;
+}
+
+void timer_set_load(const timer_frc_t frc, const uint32_t load)
+{
+    /* Writing the load register restarts the count down */
+    frc1.load = load & 0x7FFFFF;
+    frc1_arm();
+}
+
+uint32_t timer_get_load(const timer_frc_t frc)
+{
+    return frc1.load;
+}
+
+void timer_set_reload(const timer_frc_t frc, const bool reload)
+{
+    frc1.reload = reload;
+}
+
+void timer_set_interrupts(const timer_frc_t frc, bool enable)
+{
+    frc1.interrupts = enable;
+}
+
+void timer_set_run(const timer_frc_t frc, const bool run)
+{
+    if (run && !frc1.run)
+        frc1_arm();
+    frc1.run = run;
+}
+
+uint32_t timer_time_to_count(const timer_frc_t frc, uint32_t us, const timer_clkdiv_t div)
+{
+    return (uint32_t)(((uint64_t)us * SIM_TICKS_PER_US) >> div);
+}
+
+int timer_set_frequency(const timer_frc_t frc, uint32_t freq)
+{
+    /* Same prescaler choice as esp-open-rtos */
+    timer_clkdiv_t div = freq < 100 ? TIMER_CLKDIV_256
+            : freq < 10000 ? TIMER_CLKDIV_16 : TIMER_CLKDIV_1;
+    uint32_t counts = (80000000UL >> div) / freq;
+
+    if (!freq || counts > 0x7FFFFF)
+        return -1;
+    timer_set_divider(frc, div);
+    timer_set_load(frc, counts);
+    timer_set_reload(frc, true);
+    return 0;
+}
+
+void _xt_isr_attach(uint8_t inum, void (*handler)(void *), void *arg)
+{
+    if (inum == INUM_TIMER_FRC1) {
+        frc1_handler = handler;
+        frc1_arg = arg;
+    }
+}
+
+/* timers.h */
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload,
+        void *id, TimerCallbackFunction_t callback)
+{
+    sim_timer_t *timer = calloc(1, sizeof(*timer));
+
+    timer->period = period ? period : 1;
+    timer->reload = reload;
+    timer->id = id;
+    timer->callback = callback;
+    timer->next = timers;
+    timers = timer;
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t handle, TickType_t wait)
+{
+    sim_timer_t *timer = handle;
+
+    /* one period from the current tick, as FreeRTOS does */
+    timer->expiry = (sim_now / SIM_RTOS_TICK + timer->period) * SIM_RTOS_TICK;
+    timer->active = true;
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t handle, TickType_t wait)
+{
+    ((sim_timer_t *)handle)->active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t handle, TickType_t period, TickType_t wait)
+{
+    ((sim_timer_t *)handle)->period = period ? period : 1;
+    return xTimerStart(handle, wait);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t handle, TickType_t wait)
+{
+    sim_timer_t **link;
+
+    for (link = &timers; *link; link = &(*link)->next) {
+        if (*link == handle) {
+            *link = ((sim_timer_t *)handle)->next;
+            free(handle);
+            break;
+        }
+    }
+    return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t handle)
+{
+    return ((sim_timer_t *)handle)->id;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t function, void *param1,
+        uint32_t param2, TickType_t wait)
+{
+    function(param1, param2);
+    return pdPASS;
+}
+
+/* sysparam.h, forgotten by sim_reset() */
+
+sysparam_status_t sysparam_get_int32(const char *key, int32_t *result)
+{
+    uint8_t i;
+
+    for (i = 0; i < SIM_SYSPARAM_COUNT; i++) {
+        if (!strcmp(sysparams[i].key, key)) {
+            *result = sysparams[i].value;
+            return SYSPARAM_OK;
+        }
+    }
+    return SYSPARAM_NOTFOUND;
+}
+
+sysparam_status_t sysparam_set_int32(const char *key, int32_t value)
+{
+    uint8_t i;
+
+    for (i = 0; i < SIM_SYSPARAM_COUNT; i++) {
+        if (!sysparams[i].key[0] || !strcmp(sysparams[i].key, key)) {
+            snprintf(sysparams[i].key, sizeof(sysparams[i].key), "%s", key);
+            sysparams[i].value = value;
+            return SYSPARAM_OK;
+        }
+    }
+    return SYSPARAM_ERR_FULL;
+}
+
+/* Waveform capture */
+
+const sim_edge_t *sim_trace(uint8_t gpio_num, uint32_t *count)
+{
+    *count = gpio_num < SIM_GPIO_COUNT ? pins[gpio_num].count : 0;
+    return gpio_num < SIM_GPIO_COUNT ? pins[gpio_num].edges : NULL;
+}
+
+void sim_trace_clear(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < SIM_GPIO_COUNT; i++)
+        pins[i].count = 0;
+}
+
+void sim_measure(uint8_t gpio_num, uint64_t from, uint64_t to,
+        uint32_t glitch_ticks, sim_stats_t *stats)
+{
+    uint32_t i, count;
+    const sim_edge_t *edges = sim_trace(gpio_num, &count);
+    bool level = false;
+    uint64_t last = from, high = 0, rise = 0, edge = 0;
+    uint64_t first_rise = 0, first_high = 0, last_high = 0;
+    double sum = 0, sum2 = 0, period;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->period_min_us = INFINITY;
+
+    for (i = 0; i < count && edges[i].time <= from; i++)
+        level = edges[i].level;
+
+    for (; i < count && edges[i].time < to; i++) {
+        if (edges[i].level == level)
+            continue;
+        if (level)
+            high += edges[i].time - last;
+        if (edge && edges[i].time - edge < glitch_ticks)
+            stats->glitches++;
+        if (edges[i].level) {
+            if (rise) {
+                period = (double)(edges[i].time - rise) / SIM_TICKS_PER_US;
+                sum += period;
+                sum2 += period * period;
+                if (period < stats->period_min_us)
+                    stats->period_min_us = period;
+                if (period > stats->period_max_us)
+                    stats->period_max_us = period;
+                stats->periods++;
+            } else {
+                first_rise = edges[i].time;
+                first_high = high;
+            }
+            rise = edges[i].time;
+            last_high = high;
+        }
+        edge = last = edges[i].time;
+        level = edges[i].level;
+    }
+    if (level)
+        high += to - last;
+
+    stats->level = level;
+    stats->duty = to > from ? (double)high / (to - from) : 0;
+    if (stats->periods) {
+        /* Whole periods only, so the window edges do not skew the duty */
+        stats->duty = (double)(last_high - first_high) / (rise - first_rise);
+        stats->period_us = sum / stats->periods;
+        stats->jitter_us = sqrt(fabs(sum2 / stats->periods
+                    - stats->period_us * stats->period_us));
+    } else {
+        stats->period_min_us = 0;
+    }
+}
+
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000000LL
+        + (end.tv_nsec - start->tv_nsec);
+}
+
+void sim_task_run(void (*task)(void *), void *arg, uint64_t until)
+{
+    task_until = until;
+    if (setjmp(task_exit))
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &task_resumed);
+    task(arg);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_task_ns += elapsed_ns(&task_resumed);
+    sim_run_until((sim_now / SIM_RTOS_TICK + ticks) * SIM_RTOS_TICK);
+    if (sim_now >= task_until)
+        longjmp(task_exit, 1);
+    sim_task_wakeups++;
+    clock_gettime(CLOCK_MONOTONIC, &task_resumed);
+}
+
+/* the task wakes on the tick of the notification */
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    uint64_t timeout = wait == portMAX_DELAY ? task_until
+        : (sim_now / SIM_RTOS_TICK + wait) * SIM_RTOS_TICK;
+    uint32_t count;
+
+    sim_task_ns += elapsed_ns(&task_resumed);
+    while (!task_notified && sim_now < timeout && sim_now < task_until)
+        sim_run_until((sim_now / SIM_RTOS_TICK + 1) * SIM_RTOS_TICK);
+    if (sim_now >= task_until)
+        longjmp(task_exit, 1);
+    sim_task_wakeups++;
+    clock_gettime(CLOCK_MONOTONIC, &task_resumed);
+
+    count = task_notified;
+    if (count)
+        task_notified = clear ? 0 : count - 1;
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task_notified++;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return &task_exit;
+}
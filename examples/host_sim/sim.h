@@ -0,0 +1,78 @@
+/*
+ * Host side simulation of the ESP8266 peripherals used by the example
+ * drivers. The driver sources are compiled unchanged against the stub
+ * headers in include/; FRC1, GPIO and interrupt dispatch run on a
+ * virtual clock counting 80MHz ticks, and every output edge is recorded
+ * so the resulting waveforms can be measured.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_TICKS_PER_US 80
+#define SIM_US(us) ((uint64_t)(us) * SIM_TICKS_PER_US)
+#define SIM_MS(ms) SIM_US((uint64_t)(ms) * 1000)
+
+#define SIM_GPIO_COUNT 17
+
+/* Virtual time in 80MHz ticks */
+extern uint64_t sim_now;
+
+/* Interrupt entry latency (ticks), uniformly spread by up to isr_jitter */
+extern uint32_t sim_isr_latency;
+extern uint32_t sim_isr_jitter;
+/* Time charged for every gpio_write() */
+extern uint32_t sim_gpio_cost;
+
+/* FreeRTOS tick of the software timers (timers.h) */
+#define SIM_RTOS_TICK SIM_MS(portTICK_PERIOD_MS)
+
+/* Software timer callbacks run, and host time spent in them */
+extern uint32_t sim_timer_calls;
+extern uint64_t sim_timer_ns;
+
+void sim_reset(void);
+
+/* Runs a FreeRTOS task body on the host thread until sim_now reaches
+ * until. Its blocking calls (vTaskDelay(), task.h) run the virtual
+ * hardware and the software timers, which stand in for the other tasks.
+ * Wakeups and host time spent in the task are counted. */
+void sim_task_run(void (*task)(void *), void *arg, uint64_t until);
+
+extern uint32_t sim_task_wakeups;
+extern uint64_t sim_task_ns;
+
+/* Run the virtual hardware, including timer interrupts, up to time t */
+void sim_run_until(uint64_t t);
+
+/* Drive an input pin from outside, firing its GPIO interrupt if armed */
+void sim_gpio_input(uint8_t gpio_num, bool level);
+
+typedef struct {
+    uint64_t time;
+    bool level;
+} sim_edge_t;
+
+/* Output edges recorded per pin since the last sim_trace_clear() */
+const sim_edge_t *sim_trace(uint8_t gpio_num, uint32_t *count);
+void sim_trace_clear(void);
+
+typedef struct {
+    uint32_t periods;       /* complete rising-to-rising periods */
+    double period_us;       /* mean period */
+    double period_min_us;
+    double period_max_us;
+    double jitter_us;       /* standard deviation of the period */
+    double duty;            /* high time / total time, 0..1 */
+    uint32_t glitches;      /* high or low pulses shorter than the limit */
+    bool level;             /* level at the end of the window */
+} sim_stats_t;
+
+/* Measure the waveform of a pin between from and to. Pulses shorter
+ * than glitch_ticks are counted as glitches. */
+void sim_measure(uint8_t gpio_num, uint64_t from, uint64_t to,
+        uint32_t glitch_ticks, sim_stats_t *stats);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * Runs udplog_send() of ../dimmer/udplogger.c as the task of sim.c, with
+ * software timers writing numbered 64 byte lines through udplog_write(),
+ * and reassembles the broadcast datagrams.
+ *
+ * Every line must arrive whole and in order; the lines missing from the
+ * sequence must add up to the drops the log stream reports and to
+ * udplog_get_stats(). Reported are the delay from udplog_write() to the
+ * datagram, the wakeups of the sending task and the host time spent in it.
+ *
+ * The exit status is the number of failed scenarios.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <timers.h>
+#include <lwip/sockets.h>
+#include "sim.h"
+#include "udplogger.h"
+
+#define BENCH_SECONDS   60
+/* after the writers stop, to empty the ring */
+#define DRAIN_MS        1000
+#define LINE_LEN        64
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    /* lines per timer call */
+    uint32_t lines;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    /* not in step with a 100ms period of the sender */
+    { "idle, a line every 1.03s", 1030, 1 },
+    { "busy, 50 lines/s", 20, 1 },
+    { "burst, 400 lines every 10.03s", 10030, 400 },
+};
+
+static uint32_t next_write, next_read, missing, reported;
+static uint64_t writers_end;
+/* udplog_write() time of every line */
+static uint64_t *written_at;
+static uint32_t written_size;
+static uint64_t delay_sum, delay_max;
+static uint32_t datagrams, largest, bad_lines;
+/* the datagrams of a run, back to back */
+static char *captured;
+static size_t captured_len, captured_size;
+static struct {
+    uint64_t time;
+    size_t end;
+} *datagram;
+static uint32_t datagram_size;
+static char partial[LINE_LEN * 2];
+static size_t partial_len;
+
+static void line_format(char *line, uint32_t seq)
+{
+    int len = snprintf(line, LINE_LEN + 1, "%08u ", seq);
+
+    memset(line + len, 'a' + seq % 26, LINE_LEN - 1 - len);
+    line[LINE_LEN - 1] = '\n';
+}
+
+static void writer(TimerHandle_t timer)
+{
+    const scenario_t *s = pvTimerGetTimerID(timer);
+    char line[LINE_LEN + 1];
+    uint32_t i;
+
+    if (sim_now >= writers_end) {
+        xTimerStop(timer, 0);
+        return;
+    }
+    for (i = 0; i < s->lines; i++) {
+        if (next_write == written_size) {
+            written_size = written_size ? 2 * written_size : 4096;
+            written_at = realloc(written_at, written_size * sizeof(*written_at));
+        }
+        written_at[next_write] = sim_now;
+        line_format(line, next_write++);
+        udplog_write(NULL, 1, line, LINE_LEN);
+    }
+}
+
+static void line_check(const char *line, size_t len, uint64_t sent_at)
+{
+    char want[LINE_LEN + 1];
+    unsigned seq, count;
+
+    if (sscanf(line, "udplog: %u writes dropped\n", &count) == 1) {
+        reported += count;
+        return;
+    }
+    if (len != LINE_LEN || sscanf(line, "%08u ", &seq) != 1 || seq < next_read) {
+        bad_lines++;
+        return;
+    }
+    line_format(want, seq);
+    if (memcmp(line, want, LINE_LEN))
+        bad_lines++;
+    missing += seq - next_read;
+    next_read = seq + 1;
+    delay_sum += sent_at - written_at[seq];
+    if (sent_at - written_at[seq] > delay_max)
+        delay_max = sent_at - written_at[seq];
+}
+
+int lwip_socket(int domain, int type, int protocol)
+{
+    return 3;
+}
+
+int lwip_bind(int s, const struct sockaddr *name, int namelen)
+{
+    return 0;
+}
+
+/* only copies, the lines are checked after the run */
+int lwip_sendto(int s, const void *data, size_t size, int flags,
+        const struct sockaddr *to, int tolen)
+{
+    if (captured_len + size > captured_size) {
+        captured_size = 2 * (captured_len + size);
+        captured = realloc(captured, captured_size);
+    }
+    if (datagrams == datagram_size) {
+        datagram_size = datagram_size ? 2 * datagram_size : 1024;
+        datagram = realloc(datagram, datagram_size * sizeof(*datagram));
+    }
+    memcpy(captured + captured_len, data, size);
+    datagram[datagrams].time = sim_now;
+    datagram[datagrams].end = captured_len += size;
+    datagrams++;
+    return size;
+}
+
+static void capture_check(void)
+{
+    uint32_t i;
+    size_t offset = 0, start;
+
+    for (i = 0; i < datagrams; i++) {
+        start = offset;
+        if (datagram[i].end - start > largest)
+            largest = datagram[i].end - start;
+        /* lines may span datagrams */
+        for (; offset < datagram[i].end; offset++) {
+            if (partial_len == sizeof(partial)) {
+                bad_lines++;
+                partial_len = 0;
+            }
+            partial[partial_len++] = captured[offset];
+            if (captured[offset] == '\n') {
+                partial[partial_len] = 0;
+                line_check(partial, partial_len, datagram[i].time);
+                partial_len = 0;
+            }
+        }
+    }
+}
+
+static int bench(const scenario_t *s)
+{
+    TimerHandle_t timer;
+    udplog_stats_t before, after;
+    uint32_t written, dropped, sent;
+
+    sim_reset();
+    udplog_get_stats(&before);
+    written = next_write;
+    missing = reported = datagrams = largest = bad_lines = 0;
+    captured_len = 0;
+    delay_sum = delay_max = 0;
+
+    writers_end = SIM_MS(BENCH_SECONDS * 1000ULL);
+    timer = xTimerCreate(NULL, pdMS_TO_TICKS(s->period_ms), pdTRUE, (void *)s, writer);
+    xTimerStart(timer, 0);
+    sim_task_run(udplog_send, NULL, writers_end + SIM_MS(DRAIN_MS));
+    xTimerDelete(timer, 0);
+    capture_check();
+
+    udplog_get_stats(&after);
+    written = next_write - written;
+    dropped = after.dropped - before.dropped;
+    /* the lines dropped at the end of the run */
+    missing += next_write - next_read;
+    next_read = next_write;
+    sent = written - dropped;
+    printf("%s: %u lines, %u dropped, %u datagrams (%u bytes at most),"
+            " %u bytes waiting at most\n", s->name, written, dropped,
+            datagrams, largest, after.max_used);
+    printf("  delay %.1f ms mean, %.1f ms max; %.1f wakeups/s, %.0f ns per wakeup,"
+            " %.0f ns per second\n",
+            sent ? (double)delay_sum / sent / SIM_MS(1) : 0.0,
+            (double)delay_max / SIM_MS(1),
+            (double)sim_task_wakeups * 1000 / sim_now * SIM_MS(1),
+            sim_task_wakeups ? (double)sim_task_ns / sim_task_wakeups : 0.0,
+            (double)sim_task_ns * 1000 / sim_now * SIM_MS(1));
+
+    /* the task starts over, and reports the drops of earlier runs again */
+    if (bad_lines || partial_len || largest > 1400
+            || missing != dropped || reported != after.dropped) {
+        printf("  FAIL: %u torn lines, %u missing, %u reported\n",
+                bad_lines, missing, reported - before.dropped);
+        return 1;
+    }
+    return 0;
+}
+
+/* udplog_printf() output beyond its buffer is cut and counted */
+static int truncate_check(void)
+{
+    udplog_stats_t before, after;
+    char long_line[200];
+
+    memset(long_line, 'x', sizeof(long_line) - 1);
+    long_line[sizeof(long_line) - 1] = 0;
+    udplog_get_stats(&before);
+    udplog_printf("%s\n", long_line);
+    udplog_printf("short\n");
+    udplog_get_stats(&after);
+    printf("truncation: %u of 2 lines truncated, %u bytes written\n",
+            after.truncated - before.truncated, after.written - before.written);
+    if (after.truncated - before.truncated != 1
+            || after.written - before.written != 127 + 6) {
+        printf("  FAIL\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    size_t i;
+
+    printf("udplog ring of %u bytes, %d simulated seconds\n",
+            UDPLOG_RING_SIZE, BENCH_SECONDS);
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        failed += bench(&scenarios[i]);
+    failed += truncate_check();
+    return failed;
+}
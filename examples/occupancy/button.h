@@ -1,7 +1,14 @@
 #pragma once
 
+#include "gesture.h"
+
 typedef void (*button_callback_fn)(uint8_t gpio_num, bool button_is_pressed, uint32_t period);
 
+typedef void (*button_gesture_fn)(uint8_t gpio_num, const gesture_event_t *event);
+
+/* interval of the debounced samples, gesture_config_t.sample_ms */
+#define BUTTON_SAMPLE_MS 10
+
 /** 
     Starts monitoring the given GPIO pin for the pressed value. Events are received through the callback.
 
@@ -13,9 +20,21 @@ typedef void (*button_callback_fn)(uint8_t gpio_num, bool button_is_pressed, uin
 */
 int button_create(uint8_t gpio_num, bool pressed_value, button_callback_fn callback);
 
+/**
+    Recognizes gestures on a button, see gesture.h; the callback is called
+    from the timer task. The callback of button_create() may be NULL then.
+
+    @param gpio_num A GPIO pin monitored with button_create()
+    @param config Gesture timing, kept by reference, sample_ms BUTTON_SAMPLE_MS
+    @param callback The callback that is called for every recognized gesture
+    @return A negative integer if this method fails.
+*/
+int button_set_gestures(uint8_t gpio_num, const gesture_config_t *config, button_gesture_fn callback);
+
 /** 
-    Removes the given GPIO pin from monitoring.
+    Removes the given GPIO pin from monitoring. The button is freed by the
+    timer task, which needs INCLUDE_xTimerPendFunctionCall.
 
     @param gpio_num The GPIO pin that should be removed from monitoring
 */
-void button_destroy(uint8_t gpio_num);
+void button_delete(uint8_t gpio_num);
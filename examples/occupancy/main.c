@@ -59,7 +59,16 @@ const int pir_gpio = 3;
 
 int enable_ota_after_powerup_press = 1;
 
-void button_callback(uint8_t gpio, bool button_is_pressed, uint32_t period);
+void button_gesture(uint8_t gpio, const gesture_event_t *event);
+
+/* click toggles, holding 2..5s, 5..10s or 10..15s resets; every repeat
+   while held reports the seconds so far, with a blink at each threshold */
+const gesture_config_t button_gestures = {
+    .sample_ms = BUTTON_SAMPLE_MS,
+    .hold_ms = 2000,
+    .repeat_ms = 1000,
+    .max_clicks = 1,
+};
 
 void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
@@ -226,20 +235,14 @@ void accessory_identify(homekit_value_t _value) {
     xTaskCreate(accessory_identify_task, "Accessory identify", 128, (void *)3/*blink_count in pvParameters*/, 2, NULL);
 }
 
-void button_callback(uint8_t gpio, bool button_is_pressed, uint32_t pressed_period) {
-    if (button_is_pressed) {
-        printf("button is still being pressed for %ums\n", pressed_period);
-        if (pressed_period == 2000) {
-            xTaskCreate(accessory_identify_task, "Accessory identify", 128, (void *)2, 2, NULL);
-        } else if (pressed_period == 5000) {
-            xTaskCreate(accessory_identify_task, "Accessory identify", 128, (void *)3, 2, NULL);
-        } else if (pressed_period == 10000) {
-            xTaskCreate(accessory_identify_task, "Accessory identify", 128, (void *)4, 2, NULL);
-        }
-        return;
-    }
-    printf("button was kept pressed for %u ms and now released.\n", pressed_period);
-    if ((pressed_period > 100) && (pressed_period < 1000)) {
+void button_gesture(uint8_t gpio, const gesture_event_t *event) {
+    uint32_t blinks = 0;
+
+    switch (event->type) {
+    case GESTURE_CLICK:
+        printf("button was kept pressed for %u ms and now released.\n", event->held_ms);
+        if (event->held_ms >= 1000)
+            break;
         if (enable_ota_after_powerup_press) {
             printf("Request OTA Update, restarting\n");
             rboot_set_temp_rom(1);
@@ -248,13 +251,31 @@ void button_callback(uint8_t gpio, bool button_is_pressed, uint32_t pressed_peri
             printf("Toggling relay.\n");
             switch_toggle();
         }
-    } else
-    if ((pressed_period > 2000) && (pressed_period <= 5000)) {
-        reset_configuration(FLAG_UPDATE_OTA);
-    } else if ((pressed_period > 5000) && (pressed_period <= 10000)) {
-        reset_configuration(FLAG_RESET_HOMEKIT);
-    } else if ((pressed_period > 10000) && (pressed_period <= 15000)) {
-        reset_configuration(FLAG_RESET_WIFI | FLAG_RESET_HOMEKIT | FLAG_UPDATE_OTA);
+        break;
+    case GESTURE_HOLD:
+    case GESTURE_REPEAT:
+        printf("button is still being pressed for %ums\n", event->held_ms);
+        /* one event per second, whichever sample it falls on */
+        if (event->held_ms < 3000) {
+            blinks = 2;
+        } else if ((event->held_ms >= 5000) && (event->held_ms < 6000)) {
+            blinks = 3;
+        } else if ((event->held_ms >= 10000) && (event->held_ms < 11000)) {
+            blinks = 4;
+        }
+        if (blinks)
+            xTaskCreate(accessory_identify_task, "Accessory identify", 128, (void *)blinks, 2, NULL);
+        break;
+    case GESTURE_RELEASE:
+        printf("button was kept pressed for %u ms and now released.\n", event->held_ms);
+        if (event->held_ms <= 5000) {
+            reset_configuration(FLAG_UPDATE_OTA);
+        } else if (event->held_ms <= 10000) {
+            reset_configuration(FLAG_RESET_HOMEKIT);
+        } else if (event->held_ms <= 15000) {
+            reset_configuration(FLAG_RESET_WIFI | FLAG_RESET_HOMEKIT | FLAG_UPDATE_OTA);
+        }
+        break;
     }
 }
 
@@ -322,7 +343,7 @@ void on_wifi_ready() {
     /* capture with: sudo tcpdump -i enp3s0 udp port 45678 -v -X */
 
     UDPLOG("on_wifi_ready(); redirecting printf() to udplog_writer\n");
-    xTaskCreate(udplog_send, "logsend", 256, NULL, 4/*prio*/, NULL);
+    xTaskCreate(udplog_send, "logsend", 512, NULL, 1/*prio*/, NULL);
     set_write_stdout(udplog_write);
 
     /* this can be used to reset redirection, typically printf() */
@@ -394,7 +415,8 @@ void user_init(void) {
 #endif
     gpio_init();
 
-    if (button_create(button_gpio, 0, button_callback)) {
+    if (button_create(button_gpio, 0, NULL) ||
+        button_set_gestures(button_gpio, &button_gestures, button_gesture)) {
         printf("Failed to initialize button\n");
     }
 
@@ -2,19 +2,65 @@
 #ifndef __UDPLOGGER_H__
 #define __UDPLOGGER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct _reent;
+
 //use nc -kulnw0 45678 to collect this output
-//and use     xTaskCreate(udplog_send, "logsend", 256, NULL, 4, NULL); //is prio4 a good idea??
+//and use     xTaskCreate(udplog_send, "logsend", 512, NULL, 1, NULL);
+//its snprintf() of the drop report needs more than 256 words of stack
+
+/*
+    Log output waits in a byte ring until udplog_send() broadcasts it.
+    Writers in any task append a whole write or, when it does not fit,
+    drop all of it and count it; they never block and never tear a line.
+    The writers are serialized by suspending the scheduler for the copy;
+    udplog_send() is the only reader and runs without locking, as the
+    head index is only written by the writers and the tail only by it.
+    A line in the output reports writes dropped since the last report.
+
+    udplog_send() sleeps on its task notification while the ring is empty.
+    The first write wakes it, and it sends once UDPLOG_SEND_THRESHOLD bytes
+    are waiting or UDPLOG_FLUSH_MS later, whichever comes first. It is not
+    woken otherwise, so it can run below the application tasks; when they
+    keep it from running, the ring fills up and writes are dropped.
+*/
 
-#define UDPLOG(format, ...)      udplogstring_len+=sprintf(udplogstring+udplogstring_len,format,##__VA_ARGS__)
+#ifndef UDPLOG_RING_SIZE
+#define UDPLOG_RING_SIZE 4096
+#endif
+#ifndef UDPLOG_FLUSH_MS
+#define UDPLOG_FLUSH_MS 40
+#endif
+
+#define UDPLOG(format, ...)      udplog_printf(format,##__VA_ARGS__)
 #define UDPLGP(format, ...)  do {printf(format,##__VA_ARGS__); \
-                                 udplogstring_len+=sprintf(udplogstring+udplogstring_len,format,##__VA_ARGS__); \
+                                 udplog_printf(format,##__VA_ARGS__); \
                                 } while(0)
+
+typedef struct {
+    /* bytes appended to the ring */
+    uint32_t written;
+    /* writes that did not fit, and their bytes */
+    uint32_t dropped;
+    uint32_t dropped_bytes;
+    /* udplog_printf() lines cut to fit its buffer */
+    uint32_t truncated;
+    /* most bytes ever waiting */
+    uint32_t max_used;
+} udplog_stats_t;
+
 void udplog_send(void *pvParameters);
 
 /* allows stdout redirection */
 ssize_t udplog_write(struct _reent *r, int fd, const void *ptr, size_t len);
 
-extern char udplogstring[];
-extern int udplogstring_len;
+/* formats into a 128 byte buffer on the stack, then appends it; longer
+   output is cut to 127 bytes and counted as truncated */
+void udplog_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+void udplog_get_stats(udplog_stats_t *stats);
 
 #endif //__UDPLOGGER_H__
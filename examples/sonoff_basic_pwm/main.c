@@ -51,6 +51,9 @@ const int toggle_gpio = 14;
 #include <pwm.h>
 // The PWM pin that is connected to the PWM daughter board.
 const int pwm_gpio = 13;
+// Well above what cameras pick up as flicker; pwm_set_freq reports the
+// duty resolution left at this frequency.
+#define PWM_FREQ 4000
 
 const bool dev = true;
 
@@ -109,10 +112,18 @@ void gpio_init() {
 }
 
 
+// Round a 16 bit duty to the nearest step the PWM can actually produce
+uint16_t pwm_quantize(int w) {
+    int q = 1 << (16 - pwm_get_resolution());
+    w = (w + q/2) / q * q;
+    return w > UINT16_MAX ? UINT16_MAX : w;
+}
+
+
 void lightSET_task(void *pvParameters) {
     int w;
     if (on) {
-        w = (UINT16_MAX - UINT16_MAX*bri/100);
+        w = pwm_quantize(UINT16_MAX - UINT16_MAX*bri/100);
         pwm_set_duty(w);
         printf("ON  %3d [%5d]\n", (int)bri , w);
     } else {
@@ -133,8 +144,8 @@ void light_init() {
     on=false;
     bri=100;
     printf("on = false  bri = 100 %%\n");
-    pwm_set_freq(1000);
-    printf("PWMpwm_set_freq = 1000 Hz  pwm_set_duty = 0 = 0%%\n");
+    uint8_t bits = pwm_set_freq(PWM_FREQ);
+    printf("PWMpwm_set_freq = %d Hz (%d bit)  pwm_set_duty = 0 = 0%%\n", PWM_FREQ, bits);
     pwm_set_duty(UINT16_MAX);
     pwm_start();
     lightSET();
@@ -12,6 +12,17 @@
 #include <FreeRTOS.h>
 #include <esp8266.h>
 
+/* FRC1 counts at 80MHz before the prescaler and has a 23 bit load */
+#define PWM_TIMER_CLK       80000000UL
+#define PWM_TIMER_MAX_LOAD  0x7FFFFF
+
+/* Time from FRC1 expiry until the next load is armed, in 80MHz ticks
+ * (interrupt entry, dispatch and frc1_interrupt_handler). A phase shorter
+ * than this cannot be produced, so it bounds the usable duty range. */
+#ifndef PWM_ISR_COST
+#define PWM_ISR_COST        320
+#endif
+
 #ifdef PWM_DEBUG
 #define debug(fmt, ...) printf("%s: " fmt "\n", "PWM", ## __VA_ARGS__)
 #else
@@ -41,6 +52,8 @@ typedef struct pwmInfoDefinition
 
     /* private */
     uint32_t _maxLoad;
+    uint32_t _minLoad;
+    uint8_t _bits;
     uint32_t _onLoad;
     uint32_t _offLoad;
     pwm_step_t _step;
@@ -85,6 +98,8 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
 
     /* Initialize */
     pwmInfo._maxLoad = 0;
+    pwmInfo._minLoad = 0;
+    pwmInfo._bits = 0;
     pwmInfo._onLoad = 0;
     pwmInfo._offLoad = 0;
     pwmInfo._step = PERIOD_ON;
@@ -113,8 +128,61 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
     debug("PWM Init");
 }
 
-void pwm_set_freq(uint16_t freq)
+static const struct {
+    timer_clkdiv_t div;
+    uint16_t shift;
+} pwm_dividers[] = {
+    { TIMER_CLKDIV_1, 0 },
+    { TIMER_CLKDIV_16, 4 },
+    { TIMER_CLKDIV_256, 8 },
+};
+
+uint8_t pwm_calc_resolution(uint16_t freq, pwm_timing_t *timing)
+{
+    uint8_t i, bits;
+    uint32_t maxLoad, minLoad, steps;
+
+    if (!freq)
+        return 0;
+
+    /* The finest prescaler whose period still fits the counter wins */
+    for (i = 0; i < sizeof(pwm_dividers) / sizeof(pwm_dividers[0]); ++i)
+    {
+        maxLoad = (PWM_TIMER_CLK >> pwm_dividers[i].shift) / freq;
+        if (maxLoad <= PWM_TIMER_MAX_LOAD)
+            break;
+    }
+    if (i == sizeof(pwm_dividers) / sizeof(pwm_dividers[0]))
+        return 0;
+
+    minLoad = (PWM_ISR_COST + (1 << pwm_dividers[i].shift) - 1) >> pwm_dividers[i].shift;
+    if (maxLoad <= 2 * minLoad)
+        return 0;
+
+    /* Both phases must outlast the ISR, what is left are the duty steps */
+    steps = maxLoad - 2 * minLoad;
+    for (bits = 0; bits < 16 && (steps >> (bits + 1)); ++bits);
+
+    if (timing)
+    {
+        timing->divider = pwm_dividers[i].div;
+        timing->max_load = maxLoad;
+        timing->min_load = minLoad;
+        timing->bits = bits;
+    }
+    return bits;
+}
+
+uint8_t pwm_set_freq(uint16_t freq)
 {
+    pwm_timing_t timing;
+
+    if (!pwm_calc_resolution(freq, &timing))
+    {
+        debug("Frequency %u not reachable", freq);
+        return 0;
+    }
+
     /* Stop now to avoid load being used */
     if (pwmInfo.running)
     {
@@ -122,18 +190,25 @@ void pwm_set_freq(uint16_t freq)
         pwmInfo.running = 1;
     }
 
-    if (!timer_set_frequency(FRC1, freq))
-    {
-        pwmInfo._maxLoad = timer_get_load(FRC1);
-        pwmInfo.freq = freq;
-        debug("Frequency set at %u",pwmInfo.freq);
-        debug("MaxLoad is %u",pwmInfo._maxLoad);
-    }
+    timer_set_divider(FRC1, timing.divider);
+    timer_set_load(FRC1, timing.max_load);
+    pwmInfo._maxLoad = timing.max_load;
+    pwmInfo._minLoad = timing.min_load;
+    pwmInfo._bits = timing.bits;
+    pwmInfo.freq = freq;
+    debug("Frequency set at %u",pwmInfo.freq);
+    debug("MaxLoad is %u, %u bits",pwmInfo._maxLoad,pwmInfo._bits);
 
     if (pwmInfo.running)
     {
         pwm_start();
     }
+    return timing.bits;
+}
+
+uint8_t pwm_get_resolution()
+{
+    return pwmInfo._bits;
 }
 
 void pwm_set_duty(uint16_t duty)
@@ -158,14 +233,26 @@ void pwm_restart()
 
 void pwm_start()
 {
-    pwmInfo._onLoad = pwmInfo.dutyCycle * pwmInfo._maxLoad / UINT16_MAX;
+    /* 64 bit product: dutyCycle * _maxLoad overflows once _maxLoad > 65537 */
+    pwmInfo._onLoad = (uint64_t)pwmInfo.dutyCycle * pwmInfo._maxLoad / UINT16_MAX;
     pwmInfo._offLoad = pwmInfo._maxLoad - pwmInfo._onLoad;
     pwmInfo._step = PERIOD_ON;
 
-    if(!pwmInfo._onLoad)
+    /* Phases shorter than the ISR would glitch: snap to constant output */
+    if (pwmInfo.dutyCycle > 0 && pwmInfo.dutyCycle < UINT16_MAX)
     {
-        debug("Can't set timer with low duty and frequency settings, put duty at 0");
-        pwmInfo.dutyCycle = 0;
+        if (pwmInfo._onLoad < pwmInfo._minLoad)
+        {
+            debug("Can't set timer with low duty and frequency settings, put duty at 0");
+            pwmInfo.dutyCycle = 0;
+            pwmInfo.output = false;
+        }
+        else if (pwmInfo._offLoad < pwmInfo._minLoad)
+        {
+            debug("Can't set timer with high duty and frequency settings, put duty at max");
+            pwmInfo.dutyCycle = UINT16_MAX;
+            pwmInfo.output = true;
+        }
     }
 
     // 0% and 100% duty cycle are special cases: constant output.
@@ -9,6 +9,7 @@
 #define EXTRAS_PWM_H_
 
 #include <stdint.h>
+#include <esp/timer.h>
 
 #define MAX_PWM_PINS    8
 
@@ -18,6 +19,14 @@ extern "C" {
 
 //Warning: Printf disturb pwm. You can use "uart_putc" instead.
 
+/* FRC1 settings chosen for a PWM frequency */
+typedef struct {
+    timer_clkdiv_t divider;
+    uint32_t max_load;      /* timer ticks per PWM period */
+    uint32_t min_load;      /* shortest phase the ISR can keep up with */
+    uint8_t bits;           /* effective duty resolution */
+} pwm_timing_t;
+
 /**
  * Initialize pwm
  * @param npins Number of pwm pin used
@@ -27,10 +36,28 @@ extern "C" {
 void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse);
 
 /**
- * Set PWM frequency. If error, frequency not set
+ * Compute the timer settings and duty resolution reachable at a frequency,
+ * taking the FRC1 prescaler and the ISR cost (PWM_ISR_COST) into account
  * @param freq PWM frequency value in Hertz
- */  
-void pwm_set_freq(uint16_t freq);
+ * @param timing If not NULL, receives the chosen timer settings
+ * @return Effective duty resolution in bits, 0 if not reachable
+ */
+uint8_t pwm_calc_resolution(uint16_t freq, pwm_timing_t *timing);
+
+/**
+ * Set PWM frequency, using the prescaler that gives the finest duty
+ * resolution. If error, frequency not set
+ * @param freq PWM frequency value in Hertz
+ * @return Effective duty resolution in bits, 0 on error
+ */
+uint8_t pwm_set_freq(uint16_t freq);
+
+/**
+ * Effective duty resolution at the current frequency. Only the top
+ * bits of the 16 bit duty passed to pwm_set_duty are significant
+ * @return Resolution in bits
+ */
+uint8_t pwm_get_resolution();
 
 /**
  * Set Duty between 0 and UINT16_MAX
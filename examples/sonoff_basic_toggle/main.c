@@ -134,6 +134,15 @@ void toggle_callback(uint8_t gpio) {
             switch_on.value.bool_value = !switch_on.value.bool_value;
             relay_write(switch_on.value.bool_value);
             homekit_characteristic_notify(&switch_on, switch_on.value);
+
+            toggle_stats_t stats;
+            toggle_get_stats(&stats);
+            if (stats.uptime_ms) {
+                printf("Toggle wakeups per hour: %u (%u edges, %u activations), polling: %u\n",
+                    (uint32_t)(stats.wakeups * 3600000ULL / stats.uptime_ms),
+                    stats.edges, stats.activations,
+                    (uint32_t)(stats.polled_wakeups * 3600000ULL / stats.uptime_ms));
+            }
 }
 //
 
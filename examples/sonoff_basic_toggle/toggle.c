@@ -1,5 +1,7 @@
 #include <string.h>
 #include <esplibs/libmain.h>
+#include <FreeRTOS.h>
+#include <task.h>
 #include "toggle.h"
 
 #define LPF_SHIFT 3  // divide by 8
@@ -22,6 +24,8 @@ typedef struct _toggle {
 toggle_t *toggles = NULL;
 TaskHandle_t task_handle = NULL;
 
+static toggle_stats_t stats;
+
 static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
     toggle_t *toggle = toggles;
     while (toggle && toggle->gpio_num != gpio_num)
@@ -30,30 +34,63 @@ static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
     return toggle;
 }
 
+// Any edge wakes the filter task; it does not find the toggle, so no lookup
+void toggle_intr_callback(uint8_t gpio) {
+    BaseType_t woken = pdFALSE;
+
+    stats.edges++;
+    if (task_handle)
+        vTaskNotifyGiveFromISR(task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 void toggleService(void *_args) {
     const TickType_t xPeriod = pdMS_TO_TICKS(LPF_INTERVAL);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+    TickType_t xLastWakeTime;
 
     for (;;) {
-        toggle_t *toggle = toggles;
-        uint8_t state = 0;
-        
-        while (toggle) {
-            toggle->value += ((gpio_read(toggle->gpio_num) * maxvalue_unsigned(toggle->value)) - toggle->value) >> LPF_SHIFT ;
-            state = (toggle->value > (maxvalue_unsigned(toggle->value) / 2));
-
-            if (state != toggle->state) {
-                toggle->state = state;
-                toggle->callback(toggle->gpio_num);
+        // suspended until an edge, so the CPU may sleep meanwhile
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        stats.activations++;
+        xLastWakeTime = xTaskGetTickCount();
+
+        // low-pass filter every LPF_INTERVAL until all inputs settle
+        bool settled;
+        do {
+            toggle_t *toggle = toggles;
+            uint8_t state = 0;
+            int32_t step;
+
+            stats.wakeups++;
+            settled = true;
+            while (toggle) {
+                step = ((int32_t)(gpio_read(toggle->gpio_num) * maxvalue_unsigned(toggle->value)) - toggle->value) >> LPF_SHIFT;
+                toggle->value += step;
+                state = (toggle->value > (maxvalue_unsigned(toggle->value) / 2));
+                // the filter has converged once its step rounds to nothing
+                if (step && step != -1)
+                    settled = false;
+
+                if (state != toggle->state) {
+                    toggle->state = state;
+                    toggle->callback(toggle->gpio_num);
+                }
+
+                toggle = toggle->next;
             }
-            
-            toggle = toggle->next;
-        }
 
-        vTaskDelayUntil(&xLastWakeTime, xPeriod);
+            vTaskDelayUntil(&xLastWakeTime, xPeriod);
+        } while (!settled);
     }
 }
 
+void toggle_get_stats(toggle_stats_t *stats_out) {
+    *stats_out = stats;
+    stats_out->uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    // what sampling every LPF_INTERVAL would have cost
+    stats_out->polled_wakeups = stats_out->uptime_ms / LPF_INTERVAL;
+}
+
 int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
     if (task_handle == NULL) {
         BaseType_t created = xTaskCreate(toggleService, "toggleService", 255, NULL, 2, &task_handle);
@@ -72,8 +109,9 @@ int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
     toggle->gpio_num = gpio_num;
     toggle->callback = callback;
 
-    // initial state is as initilised
+    // initial state is as initilised, with the filter settled on it
     toggle->state = gpio_read(gpio_num);
+    toggle->value = toggle->state ? maxvalue_unsigned(toggle->value) : 0;
 
     uint32_t now = xTaskGetTickCountFromISR();
     toggle->last_event_time = now;
@@ -82,7 +120,8 @@ int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
     toggles = toggle;
 
     gpio_set_pullup(toggle->gpio_num, true, true);
-    
+    gpio_set_interrupt(toggle->gpio_num, GPIO_INTTYPE_EDGE_ANY, toggle_intr_callback);
+
     return 0;
 }
 
@@ -90,6 +129,8 @@ void toggle_delete(const uint8_t gpio_num) {
     if (!toggles)
         return;
 
+    gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+
     if (toggles->gpio_num == gpio_num) {
         toggles = toggles->next;
     } else {
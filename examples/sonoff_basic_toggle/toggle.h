@@ -4,6 +4,18 @@
 
 typedef void (*toggle_callback_fn)(uint8_t gpio_num);
 
+typedef struct {
+    // GPIO edges seen on all toggles
+    uint32_t edges;
+    // filter task woken up from suspension by an edge
+    uint32_t activations;
+    // filter passes, each one a task wakeup
+    uint32_t wakeups;
+    // wakeups a filter running every 10ms would have had, and the time base
+    uint32_t polled_wakeups;
+    uint32_t uptime_ms;
+} toggle_stats_t;
+
 /** 
     Starts monitoring the given GPIO pin for change of state. Events are recieved through the callback.
 
@@ -19,3 +31,8 @@ int toggle_create(uint8_t gpio_num, toggle_callback_fn callback);
     @param gpio_num The GPIO pin that should be removed from monitoring
 */
 void toggle_delete(uint8_t gpio_num);
+
+/**
+    @param stats Receives the wakeup counters of the filter task
+*/
+void toggle_get_stats(toggle_stats_t *stats);